@@ -0,0 +1,51 @@
+/**
+ * @file 	clone.h
+ * @author 	sb
+ * @brief 	parallel materialization of the files of a scaffold
+ */
+
+#ifndef CLONE_H
+#define CLONE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include "../inc/durable.h"
+
+/* structure */
+struct p_cjob {
+	int rfd;		/* directory src is relative to */
+	const char *src;	/* file below rfd, NULL for a buffer */
+	const void *d;		/* contents of an in-memory file */
+	mode_t mode;		/* permission bits of an in-memory file */
+	const char *dest;	/* file relative to dfd */
+	struct stat st;		/* stat of the source, set by the copy */
+	struct stat ds;		/* stat of the written destination */
+	int serr;		/* errno of the source, 0 if it was read */
+	int derr;		/* errno of the destination, 0 once written */
+	int yerr;		/* errno of the sync asked for, 0 once synced */
+};
+
+/* called for every file as soon as it is finished, one call at a time */
+typedef void (*p_clone_fn)(struct p_cjob *j, void *arg);
+
+/**
+ * @function p_clone_tree
+ * @brief function to write a list of files on several threads
+ * @params [in] j are the files, their directories have to exist
+ * @params [in] n is the number of files
+ * @params [in] dfd is the directory the destinations are relative to
+ * @params [in] jobs is the maximum number of threads writing at a time
+ * @params [in] dur is the durability every file is synced with, may be NULL
+ * @params [in] done is called with every finished entry, may be NULL
+ * @params [in] arg is passed on to done
+ * @notes every file is reflinked when the filesystem shares blocks and
+ * copied inside the kernel otherwise, and synced by the thread which wrote
+ * it; recording its directories with p_durable_path is left to done. The
+ * calling thread takes part; the result of each file is left in its entry.
+ * The calls of done are serialized, so it may keep state of its own without
+ * locking
+ */
+void p_clone_tree(struct p_cjob *j, size_t n, int dfd, int jobs,
+		const struct p_durable *dur, p_clone_fn done, void *arg);
+
+#endif
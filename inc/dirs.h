@@ -0,0 +1,61 @@
+/**
+ * @file 	dirs.h
+ * @author 	sb
+ * @brief 	recursive directory creation with a set of known prefixes
+ */
+
+#ifndef DIRS_H
+#define DIRS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* macros */
+#ifndef DIRS_CHUNK
+#define DIRS_CHUNK 64
+#endif
+
+#ifndef DIRS_MODE
+#define DIRS_MODE 0775
+#endif
+
+/* structure */
+struct p_dir_slot {
+	uint64_t h;	/* hash of the path */
+	char *s;	/* path, NULL for an empty slot */
+	size_t l;	/* length of the path */
+};
+
+struct p_dirs {
+	struct p_dir_slot *t;	/* open addressed table */
+	size_t n;		/* directories known to exist */
+	size_t cap;		/* slots in t, a power of two */
+};
+
+/**
+ * @function p_dirs_init
+ * @brief function to initialize an empty set of directories
+ * @params [in] d is a pointer to a struct p_dirs instance
+ */
+void p_dirs_init(struct p_dirs *d);
+
+/**
+ * @function p_dirs_make
+ * @brief function to create a directory and all its missing parents
+ * @params [in] d is a pointer to a struct p_dirs instance
+ * @params [in] dfd is the directory path is relative to, or AT_FDCWD
+ * @params [in] path is the directory to be created
+ * @notes every prefix is created or checked once for the lifetime of the
+ * set and only looked up in memory afterwards, so one set should be used for
+ * one dfd; returns 0 on success and -1 with errno set on failure
+ */
+int p_dirs_make(struct p_dirs *d, int dfd, const char *path);
+
+/**
+ * @function p_dirs_free
+ * @brief function to free the set
+ * @params [in] d is a pointer to a struct p_dirs instance
+ */
+void p_dirs_free(struct p_dirs *d);
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file 	durable.h
+ * @author 	sb
+ * @brief 	durability of the written scaffold across a crash
+ */
+
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <stddef.h>
+
+/* macros */
+#ifndef DURABLE_CHUNK
+#define DURABLE_CHUNK 16
+#endif
+
+/* enum */
+enum p_durability {
+	DURABLE_NONE,	/* leave the writeback to the kernel */
+	DURABLE_BATCH,	/* start writeback per file, one syncfs at the end */
+	DURABLE_STRICT	/* fsync every file as it is completed */
+};
+
+/* structure */
+struct p_durable {
+	enum p_durability mode;
+	int dfd;		/* directory root is relative to */
+	const char *root;	/* project directory */
+	char **dirs;	/* directories which got new entries */
+	size_t n;
+	size_t cap;
+};
+
+/**
+ * @function p_durable_parse
+ * @brief function to parse the name of a durability mode
+ * @params [in] s is one of none, batch or strict
+ * @notes returns the mode, or -1 when the name is unknown
+ */
+int p_durable_parse(const char *s);
+
+/**
+ * @function p_durable_init
+ * @brief function to prepare the syncing of a scaffold
+ * @params [in] d is a pointer to a struct p_durable instance
+ * @params [in] mode is the durability asked for
+ * @params [in] dfd is the directory root is relative to, or AT_FDCWD
+ * @params [in] root is the project directory
+ */
+void p_durable_init(struct p_durable *d, enum p_durability mode, int dfd,
+		const char *root);
+
+/**
+ * @function p_durable_file
+ * @brief function to be called once all the data of a file is written
+ * @params [in] d is a pointer to a struct p_durable instance
+ * @params [in] fd is the descriptor of the file, still open
+ * @params [in] path is the path of the file inside the project directory
+ * @notes returns 0 on success and 1 when the file could not be synced - the
+ * directories from the one of path up to the parent of the project directory
+ * are recorded for p_durable_finish, as p_durable_sync and p_durable_path do
+ */
+int p_durable_file(struct p_durable *d, int fd, const char *path);
+
+/**
+ * @function p_durable_sync
+ * @brief function to sync the data of a file, without recording its path
+ * @params [in] d is a pointer to a struct p_durable instance
+ * @params [in] fd is the descriptor of the file, still open
+ * @notes returns 0 on success and 1 when the file could not be synced; d is
+ * only read, so several threads may sync their files at once
+ */
+int p_durable_sync(const struct p_durable *d, int fd);
+
+/**
+ * @function p_durable_path
+ * @brief function to record the directories of a file for p_durable_finish
+ * @params [in] d is a pointer to a struct p_durable instance
+ * @params [in] path is the path of the file inside the project directory
+ * @notes returns 0 on success and 1 on failure; calls have to be serialized
+ */
+int p_durable_path(struct p_durable *d, const char *path);
+
+/**
+ * @function p_durable_finish
+ * @brief function to make the scaffold durable before returning
+ * @params [in] d is a pointer to a struct p_durable instance
+ * @notes returns the number of failed sync operations
+ */
+int p_durable_finish(struct p_durable *d);
+
+/**
+ * @function p_durable_free
+ * @brief function to free the directories recorded
+ * @params [in] d is a pointer to a struct p_durable instance
+ */
+void p_durable_free(struct p_durable *d);
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file 	git.h
+ * @author 	sb
+ * @brief 	native initialization of a git repository for the scaffold
+ */
+
+#ifndef GIT_H
+#define GIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "../inc/sha1.h"
+
+/* macros */
+#ifndef GIT_DIR
+#define GIT_DIR ".git"
+#endif
+
+#ifndef GIT_BRANCH
+#define GIT_BRANCH "master"
+#endif
+
+#ifndef GIT_MESSAGE
+#define GIT_MESSAGE "Initial commit"
+#endif
+
+#ifndef GIT_CHUNK
+#define GIT_CHUNK 64
+#endif
+
+/* bytes in a stored deflate block, 65535 at most */
+#ifndef GIT_BLOCK
+#define GIT_BLOCK 65535
+#endif
+
+#ifndef GIT_TMP_TRIES
+#define GIT_TMP_TRIES 16
+#endif
+
+/* structure */
+struct p_git_entry {
+	char *path;			/* path relative to the work tree */
+	unsigned char sha[SHA1_LEN];	/* blob name */
+	struct stat st;			/* stat of the file for the index */
+	size_t seq;			/* order in which it was added */
+};
+
+struct p_git {
+	int dfd;		/* directory wt is relative to */
+	char *wt;		/* work tree - the project directory */
+	struct p_git_entry *e;	/* files added so far */
+	size_t n;
+	size_t cap;
+	unsigned char fan[32];	/* object fan-out directories created */
+	unsigned int tmp;	/* next temporary object name */
+};
+
+/**
+ * @function p_git_init
+ * @brief function to create the repository layout in the work tree
+ * @params [in] g is a pointer to a struct p_git instance
+ * @params [in] dfd is the directory wt is relative to, or AT_FDCWD
+ * @params [in] wt is the work tree directory
+ * @params [in] reuse is set to continue in the repository of an interrupted
+ * run instead of leaving an existing one alone
+ * @notes returns 0 on success, 1 on failure and 2 when the work tree is a
+ * repository already
+ */
+int p_git_init(struct p_git *g, int dfd, const char *wt, int reuse);
+
+/**
+ * @function p_git_add
+ * @brief function to store a blob for data and stage it under path
+ * @params [in] g is a pointer to a struct p_git instance
+ * @params [in] path is the path relative to the work tree
+ * @params [in] d is the content of the file
+ * @params [in] n is the number of bytes in d
+ * @params [in] st is the stat of the written work tree file
+ * @notes for data which is in memory already, a buffer or a mapped file
+ */
+int p_git_add(struct p_git *g, const char *path, const void *d, size_t n,
+		const struct stat *st);
+
+/**
+ * @function p_git_copy
+ * @brief function to copy a file to the work tree and store it as a blob in
+ * the same pass
+ * @params [in] g is a pointer to a struct p_git instance
+ * @params [in] path is the path relative to the work tree
+ * @params [in] sfd is the source, read from its current offset
+ * @params [in] dfd is the work tree file, or -1 to store the source only
+ * @params [in] n is the number of bytes in the source
+ * @notes the file goes through one fixed block which is hashed, written to
+ * dfd and to the object, so no copy of the whole file is held; returns 0 on
+ * success, -1 if reading sfd or writing dfd failed and 1 if the object or
+ * the entry could not be stored
+ */
+int p_git_copy(struct p_git *g, const char *path, int sfd, int dfd, size_t n);
+
+/**
+ * @function p_git_add_file
+ * @brief function to stage a work tree file which was not copied by the
+ * scaffold through a buffer
+ * @params [in] g is a pointer to a struct p_git instance
+ * @params [in] path is the path relative to the work tree
+ */
+int p_git_add_file(struct p_git *g, const char *path);
+
+/**
+ * @function p_git_commit
+ * @brief function to write the trees, the commit, the branch and the index
+ * @params [in] g is a pointer to a struct p_git instance
+ * @notes the identity is taken from GIT_AUTHOR_NAME/GIT_AUTHOR_EMAIL and
+ * GIT_COMMITTER_NAME/GIT_COMMITTER_EMAIL, falling back to $USER
+ */
+int p_git_commit(struct p_git *g);
+
+/**
+ * @function p_git_free
+ * @brief function to free the staged entries
+ * @params [in] g is a pointer to a struct p_git instance
+ */
+void p_git_free(struct p_git *g);
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file 	hash.h
+ * @author 	sb
+ * @brief 	content hashing used for the resource object store
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* macros */
+#ifndef HASH_HEX_LEN
+#define HASH_HEX_LEN 16
+#endif
+
+#ifndef HASH_SEED
+#define HASH_SEED 0
+#endif
+
+/* structure */
+struct p_hash {
+	uint64_t v[4];		/* accumulator lanes */
+	uint64_t total;		/* total number of bytes consumed */
+	unsigned char mem[32];	/* bytes waiting for a full stripe */
+	size_t memsz;		/* number of bytes held in mem */
+};
+
+/**
+ * @function p_hash_init
+ * @brief function to initialize a streaming hash state
+ * @params [in] h is a pointer to a struct p_hash instance
+ * @params [in] seed is the seed for the hash
+ */
+void p_hash_init(struct p_hash *h, uint64_t seed);
+
+/**
+ * @function p_hash_update
+ * @brief function to feed more data into a streaming hash state
+ * @params [in] h is a pointer to a struct p_hash instance
+ * @params [in] d is the data to be hashed
+ * @params [in] n is the number of bytes in d
+ */
+void p_hash_update(struct p_hash *h, const void *d, size_t n);
+
+/**
+ * @function p_hash_digest
+ * @brief function to return the 64 bit digest of the data fed so far
+ * @params [in] h is a pointer to a struct p_hash instance
+ */
+uint64_t p_hash_digest(const struct p_hash *h);
+
+/**
+ * @function p_hash_buf
+ * @brief function to hash a buffer in one go
+ * @params [in] d is the data to be hashed
+ * @params [in] n is the number of bytes in d
+ */
+uint64_t p_hash_buf(const void *d, size_t n);
+
+/**
+ * @function p_hash_fd
+ * @brief function to hash the contents of an open file descriptor
+ * @params [in] fd is the file descriptor, read from its current offset
+ * @params [out] r is where the digest will be stored
+ * @notes returns 0 on success and -1 on a read error
+ */
+int p_hash_fd(int fd, uint64_t *r);
+
+/**
+ * @function p_hash_hex
+ * @brief function to format a digest as a fixed width hex string
+ * @params [in] h is the digest
+ * @params [out] s is a buffer of at least HASH_HEX_LEN + 1 bytes
+ */
+void p_hash_hex(uint64_t h, char *s);
+
+#endif
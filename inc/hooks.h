@@ -0,0 +1,119 @@
+/**
+ * @file 	hooks.h
+ * @author 	sb
+ * @brief 	post create hooks declared by a template
+ */
+
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "../inc/jsmn.h"
+
+/* macros */
+#ifndef TEMPL_HOOK_ID
+#define TEMPL_HOOK_ID "hooks"
+#endif
+
+#ifndef HOOK_CMD
+#define HOOK_CMD "cmd"
+#endif
+
+#ifndef HOOK_AFTER
+#define HOOK_AFTER "after"
+#endif
+
+#ifndef HOOK_NEEDS
+#define HOOK_NEEDS "needs"
+#endif
+
+#ifndef HOOK_SHELL
+#define HOOK_SHELL "/bin/sh"
+#endif
+
+/* enum */
+enum p_hook_state {
+	HOOK_WAITING,
+	HOOK_RUNNING,
+	HOOK_DONE,
+	HOOK_FAILED,
+	HOOK_SKIPPED
+};
+
+/* structure */
+struct p_hook {
+	char *name;	/* name of the hook in the template */
+	char *cmd;	/* shell command, run inside the project directory */
+	size_t *after;	/* indices of the hooks which have to succeed first */
+	size_t nafter;
+	char **needs;	/* project relative files the hook reads */
+	size_t nneeds;
+	size_t pending;	/* entries of needs which are not written yet */
+	pid_t pid;	/* process id while running */
+	int pfd;	/* pidfd while running, -1 if the kernel has none */
+	int out;	/* unlinked file collecting stdout and stderr */
+	int status;	/* exit code once done */
+	enum p_hook_state state;
+};
+
+struct p_hooks {
+	struct p_hook *h;	/* hooks in template order */
+	size_t n;
+	size_t running;		/* hooks currently running */
+	size_t jobs;		/* maximum number of concurrent hooks */
+	char *dir;		/* project directory, absolute or cwd relative */
+	FILE *out;		/* reports and hook output, NULL drops them */
+	int scaffolded;		/* all the files have been written */
+};
+
+/**
+ * @function p_hooks_load
+ * @brief function to load the hooks object of a template
+ * @params [in] hs is a pointer to a struct p_hooks instance
+ * @params [in] js is the JSON text of the template
+ * @params [in] t are the tokens of the template
+ * @params [in] nt is the number of tokens
+ * @params [in] i is the index of the token holding the hooks object
+ * @notes returns 0 on success and 1 on a malformed hooks object
+ */
+int p_hooks_load(struct p_hooks *hs, const char *js, const jsmntok_t *t,
+		int nt, int i);
+
+/**
+ * @function p_hooks_copy
+ * @brief function to copy loaded hooks which have not been run
+ * @params [out] d is a pointer to the struct p_hooks instance to fill
+ * @params [in] s is a pointer to the loaded hooks
+ * @notes the copy has no directory, every project sets its own; returns
+ * 0 on success and 1 on failure - a failed copy still has to be freed
+ */
+int p_hooks_copy(struct p_hooks *d, const struct p_hooks *s);
+
+/**
+ * @function p_hooks_written
+ * @brief function to report a file of the scaffold as written
+ * @params [in] hs is a pointer to a struct p_hooks instance
+ * @params [in] rel is the path of the file relative to the project
+ * @notes hooks whose needs are all written are started right away
+ */
+void p_hooks_written(struct p_hooks *hs, const char *rel);
+
+/**
+ * @function p_hooks_finish
+ * @brief function to run every remaining hook and wait for all of them
+ * @params [in] hs is a pointer to a struct p_hooks instance
+ * @notes sleeps until a running hook exits, without polling on a timer;
+ * returns the number of hooks which failed or were skipped
+ */
+int p_hooks_finish(struct p_hooks *hs);
+
+/**
+ * @function p_hooks_free
+ * @brief function to free the hooks
+ * @params [in] hs is a pointer to a struct p_hooks instance
+ */
+void p_hooks_free(struct p_hooks *hs);
+
+#endif
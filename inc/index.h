@@ -0,0 +1,104 @@
+/**
+ * @file 	index.h
+ * @author 	sb
+ * @brief 	index of the files in a resource directory for glob matching
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* macros */
+#ifndef INDEX_CHUNK
+#define INDEX_CHUNK 64
+#endif
+
+/* levels of directories held open at once, deeper ones are reopened by path */
+#ifndef INDEX_FDS
+#define INDEX_FDS 20
+#endif
+
+/* structure */
+struct p_index {
+	char **paths;	/* sorted paths of the regular files, relative */
+	size_t n;	/* number of paths */
+	size_t cap;	/* allocated slots in paths */
+};
+
+/**
+ * @function p_index_build
+ * @brief function to index every regular file below a directory
+ * @params [in] x is a pointer to a struct p_index instance
+ * @params [in] root is the directory to be indexed (with trailing /)
+ * @notes returns 0 on success and 1 on failure with errno set; a directory
+ * below root which can not be opened fails the whole index
+ */
+int p_index_build(struct p_index *x, const char *root);
+
+/**
+ * @function p_index_list
+ * @brief function to index a list of paths which are not on disk
+ * @params [in] x is a pointer to a struct p_index instance
+ * @params [in] paths are the relative paths, in any order
+ * @params [in] n is the number of paths
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_index_list(struct p_index *x, const char * const *paths, size_t n);
+
+/**
+ * @function p_index_merge
+ * @brief function to add the paths of another index which x lacks
+ * @params [in] x is a pointer to a struct p_index instance
+ * @params [in] y is the index whose paths are added
+ * @notes a path present in both is kept once; returns 0 on success and 1 on
+ * failure, which leaves x as it was
+ */
+int p_index_merge(struct p_index *x, const struct p_index *y);
+
+/**
+ * @function p_index_free
+ * @brief function to free the paths held by the index
+ * @params [in] x is a pointer to a struct p_index instance
+ */
+void p_index_free(struct p_index *x);
+
+/**
+ * @function p_is_glob
+ * @brief function to check if a build file key is a glob pattern
+ * @params [in] s is the key
+ */
+bool p_is_glob(const char *s);
+
+/**
+ * @function p_glob_match
+ * @brief function to match a path against a glob pattern
+ * @params [in] pat is the pattern - '*', '?' and '[...]' do not cross '/'
+ * while a '**' segment matches any number of directories
+ * @params [in] s is the path to be matched
+ */
+bool p_glob_match(const char *pat, const char *s);
+
+/**
+ * @function p_glob_dirlen
+ * @brief function to return the length of the literal directory part
+ * which leads the pattern, including its final '/'
+ * @params [in] pat is the pattern
+ */
+size_t p_glob_dirlen(const char *pat);
+
+/**
+ * @function p_index_glob
+ * @brief function to call fn for every indexed path matching pat
+ * @params [in] x is a pointer to a built struct p_index instance
+ * @params [in] pat is the glob pattern
+ * @params [in] fn is called with each matching path and arg
+ * @params [in] arg is passed through to fn
+ * @notes only the range of paths sharing the literal prefix of the pattern
+ * is examined; returns the number of matches
+ */
+size_t p_index_glob(const struct p_index *x, const char *pat,
+		void (*fn)(const char *path, void *arg), void *arg);
+
+#endif
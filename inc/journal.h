@@ -0,0 +1,93 @@
+/**
+ * @file 	journal.h
+ * @author 	sb
+ * @brief 	journal of the completed files of a scaffold, for --resume
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/* macros */
+#ifndef JOURNAL_FILE
+#define JOURNAL_FILE ".mkp-journal"
+#endif
+
+#ifndef JOURNAL_MAGIC
+#define JOURNAL_MAGIC "mkproject-journal 1\n"
+#endif
+
+#ifndef JOURNAL_CHUNK
+#define JOURNAL_CHUNK 64
+#endif
+
+/* structure */
+struct p_jent {
+	char *path;		/* path relative to the project */
+	uint64_t key;		/* identity of the source when it was copied */
+	off_t size;		/* size of the written file */
+	struct timespec mtim;	/* modification time of the written file */
+	size_t seq;		/* line of the entry, later lines win */
+};
+
+struct p_journal {
+	int fd;			/* journal opened for appending */
+	struct p_jent *e;	/* entries of an earlier run, sorted by path */
+	size_t n;
+	size_t cap;
+};
+
+/**
+ * @function p_journal_open
+ * @brief function to start the journal of a scaffold
+ * @params [in] j is a pointer to a struct p_journal instance
+ * @params [in] dfd is the directory root is relative to, or AT_FDCWD
+ * @params [in] root is the project directory
+ * @params [in] resume is set to load the entries of an interrupted run
+ * @notes without resume an earlier journal is discarded; returns 0 on
+ * success, 1 on failure and 2 when resume found no journal to load
+ */
+int p_journal_open(struct p_journal *j, int dfd, const char *root,
+		int resume);
+
+/**
+ * @function p_journal_done
+ * @brief function to check if a file was completed by an earlier run
+ * @params [in] j is a pointer to a struct p_journal instance
+ * @params [in] rel is the path relative to the project
+ * @params [in] key is the identity of the source now
+ * @params [in] ds is the stat of the file in the project now
+ * @notes a file is only done when the source is the same and the file was
+ * not touched since it was written
+ */
+int p_journal_done(const struct p_journal *j, const char *rel, uint64_t key,
+		const struct stat *ds);
+
+/**
+ * @function p_journal_add
+ * @brief function to append a completed file to the journal
+ * @params [in] j is a pointer to a struct p_journal instance
+ * @params [in] rel is the path relative to the project
+ * @params [in] key is the identity of the source
+ * @params [in] ds is the stat of the written file
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_journal_add(struct p_journal *j, const char *rel, uint64_t key,
+		const struct stat *ds);
+
+/**
+ * @function p_journal_close
+ * @brief function to end the journal of a scaffold
+ * @params [in] j is a pointer to a struct p_journal instance
+ * @params [in] dfd is the directory root is relative to, or AT_FDCWD
+ * @params [in] root is the project directory
+ * @params [in] done is set when every file was written, which removes the
+ * journal - otherwise it is kept for --resume
+ */
+void p_journal_close(struct p_journal *j, int dfd, const char *root,
+		int done);
+
+#endif
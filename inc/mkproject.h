@@ -0,0 +1,127 @@
+/**
+ * @file 	mkproject.h
+ * @author 	sb
+ * @brief 	embeddable interface of mkproject - libmkproject
+ */
+
+#ifndef MKPROJECT_H
+#define MKPROJECT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* enum */
+enum mkp_status {
+	MKP_OK,		/* project created or updated */
+	MKP_EINVAL,	/* missing or malformed argument */
+	MKP_ENOMEM,	/* allocation failed */
+	MKP_ECONFIG,	/* no resource directory configured */
+	MKP_ETEMPLATE,	/* template missing or not proper JSON */
+	MKP_ESOURCE,	/* a file named by the template is missing */
+	MKP_EEXIST,	/* project directory exists, neither update nor resume
+			   is set */
+	MKP_EWRITE,	/* a directory or file of the project was not written */
+	MKP_EGIT,	/* the git repository was not written */
+	MKP_ESYNC,	/* the project could not be synced to disk */
+	MKP_EHOOK,	/* a hook failed or was skipped */
+	MKP_EVERIFY	/* the project differs from its template */
+};
+
+/* structure */
+struct mkp_file {
+	const char *path;	/* path below the template, as in build_files */
+	const void *data;	/* contents */
+	size_t size;		/* number of bytes in data */
+	mode_t mode;		/* permission bits of the file, 0 for 0644 */
+};
+
+struct mkp_options {
+	int update;	/* rewrite only the files which differ */
+	int resume;	/* skip the files an interrupted run completed */
+	int git;	/* commit the scaffold to a new git repository */
+	int durability;	/* 0 none, 1 batch, 2 strict - see --durability */
+	int verify;	/* check the files against the template - see --verify */
+	int jobs;	/* maximum number of hooks or hashing threads at a time */
+	const char *with;	/* comma separated extras of the template to
+				   add, NULL for none - see --with */
+	FILE *out;	/* progress, hook output and diagnostics, NULL for none */
+};
+
+/* a template is immutable once loaded and can be shared between threads */
+struct mkp_template;
+
+/**
+ * @function mkp_options_init
+ * @brief function to fill options with the defaults of the command line
+ * @params [out] o is a pointer to a struct mkp_options instance
+ * @notes the defaults write nothing to any stream
+ */
+void mkp_options_init(struct mkp_options *o);
+
+/**
+ * @function mkp_template_load
+ * @brief function to load a template from a resource directory
+ * @params [out] t receives the template
+ * @params [in] resd is the resource directory
+ * @params [in] type is the project type - <resd>/<type>.json is read and
+ * the files are taken from <resd>/<type>/
+ * @notes as on the command line, the template and every file missing from
+ * resd are taken from the system wide store, $MKP_SYSTEM_DIR or
+ * /usr/share/mkproject; returns MKP_OK or the enum mkp_status of the failure
+ */
+int mkp_template_load(struct mkp_template **t, const char *resd,
+		const char *type);
+
+/**
+ * @function mkp_template_mem
+ * @brief function to create a template which lives in memory only
+ * @params [out] t receives the template
+ * @params [in] json is the template text, same format as <type>.json
+ * @params [in] n is the number of bytes in json
+ * @params [in] files are the files the build_files keys refer to
+ * @params [in] nfiles is the number of files
+ * @notes everything is copied, the arguments can be released afterwards;
+ * returns MKP_OK or the enum mkp_status of the failure
+ */
+int mkp_template_mem(struct mkp_template **t, const char *json, size_t n,
+		const struct mkp_file *files, size_t nfiles);
+
+/**
+ * @function mkp_template_free
+ * @brief function to release a template
+ * @params [in] t is the template, no call may be using it anymore
+ */
+void mkp_template_free(struct mkp_template *t);
+
+/**
+ * @function mkp_create
+ * @brief function to create a project from a template
+ * @params [in] t is the template
+ * @params [in] dirfd is the directory name is relative to, or AT_FDCWD
+ * @params [in] name is the project directory
+ * @params [in] o are the options, NULL for the defaults
+ * @notes reentrant - concurrent calls only have to use different project
+ * directories; nothing is written to stdout unless o->out says so. With
+ * o->verify an existing project which is neither updated nor resumed is only
+ * verified. Returns MKP_OK or the enum mkp_status of the first failure
+ */
+int mkp_create(const struct mkp_template *t, int dirfd, const char *name,
+		const struct mkp_options *o);
+
+/**
+ * @function mkp_strerror
+ * @brief function to describe an enum mkp_status value
+ * @params [in] code is the status
+ */
+const char *mkp_strerror(int code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
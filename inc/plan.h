@@ -0,0 +1,143 @@
+/**
+ * @file 	plan.h
+ * @author 	sb
+ * @brief 	resolved template of a run and the preflight check of it
+ */
+
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../inc/mkproject.h"
+
+/* macros */
+#ifndef PLAN_CHUNK
+#define PLAN_CHUNK 64
+#endif
+
+/* structure */
+struct p_pdir {
+	char *path;	/* directory, relative to dfd */
+	int err;	/* errno of the layout check, 0 if it can be made */
+};
+
+struct p_pent {
+	char *dest;	/* file in the project, relative to dfd */
+	char *src;	/* file below the type directory */
+	const struct mkp_file *m;	/* in-memory source, NULL for a file */
+	int sys;	/* the source is taken from the system layer */
+	off_t size;	/* bytes of the source, set by the check */
+	int exists;	/* the destination is a file already */
+	int serr;	/* errno of the source, 0 if it can be read */
+	int derr;	/* errno of the layout check, 0 if it can be written */
+	const void *map;	/* source mapped once for every project of a
+				   fan-out, NULL if it is opened each time */
+	struct stat st;	/* stat of the mapped source */
+};
+
+struct p_plan {
+	struct p_pdir *d;	/* directories in template order */
+	size_t nd;
+	size_t capd;
+	struct p_pent *f;	/* files in template order */
+	size_t nf;
+	size_t capf;
+};
+
+/**
+ * @function p_plan_init
+ * @brief function to initialize an empty plan
+ * @params [in] pl is a pointer to a struct p_plan instance
+ */
+void p_plan_init(struct p_plan *pl);
+
+/**
+ * @function p_plan_dir
+ * @brief function to add a directory to the plan
+ * @params [in] pl is a pointer to a struct p_plan instance
+ * @params [in] path is the directory, relative to the project's dfd
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_plan_dir(struct p_plan *pl, const char *path);
+
+/**
+ * @function p_plan_file
+ * @brief function to add a file to the plan
+ * @params [in] pl is a pointer to a struct p_plan instance
+ * @params [in] dest is the file in the project, relative to the project's dfd
+ * @params [in] src is the file below the type directory
+ * @params [in] m is the in-memory source, NULL when src is read from disk
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_plan_file(struct p_plan *pl, const char *dest, const char *src,
+		const struct mkp_file *m);
+
+/**
+ * @function p_plan_check
+ * @brief function to check the whole plan before anything is written
+ * @params [in] pl is a pointer to a struct p_plan instance
+ * @params [in] rfd is the type directory, the sources are relative to it,
+ * or -1 when it does not exist
+ * @params [in] sfd is the type directory of the system layer, or -1
+ * @params [in] dfd is the directory the destinations are relative to
+ * @params [out] need is the number of bytes the plan will write
+ * @params [out] nodes is the number of files and directories it will add
+ * @notes every source is checked with one fstatat against rfd, and one
+ * against sfd if rfd does not override it, and every destination against dfd - a path running through a file or a directory in
+ * place of a file fails. A mapped source is not looked at again. The
+ * errors are left in the entries; returns the number of entries which
+ * failed
+ */
+size_t p_plan_check(struct p_plan *pl, int rfd, int sfd, int dfd,
+		unsigned long long *need, unsigned long long *nodes);
+
+/**
+ * @function p_plan_map
+ * @brief function to map the sources of a checked plan into memory
+ * @params [in] pl is a pointer to a struct p_plan instance
+ * @params [in] rfd is the type directory, or -1
+ * @params [in] sfd is the type directory of the system layer, or -1
+ * @notes every source is opened once and stays mapped until the plan is
+ * freed, so any number of projects are written from the same pages. A
+ * source which can not be mapped is left to be opened by each project;
+ * returns the number of sources mapped
+ */
+size_t p_plan_map(struct p_plan *pl, int rfd, int sfd);
+
+/**
+ * @function p_plan_rebase
+ * @brief function to move a plan over to another project directory
+ * @params [in] pl is a pointer to a struct p_plan instance
+ * @params [in] n is the length of the project directory the plan has
+ * @params [in] root is the project directory the plan gets
+ * @notes the results of the last check are dropped, the mapped sources
+ * are kept; returns 0 on success and 1 on failure
+ */
+int p_plan_rebase(struct p_plan *pl, size_t n, const char *root);
+
+/**
+ * @function p_plan_space
+ * @brief function to check the free space below a project directory
+ * @params [in] dfd is the directory root is relative to, or AT_FDCWD
+ * @params [in] root is the project directory, which may not exist yet
+ * @params [in] need is the number of bytes to be allocated
+ * @params [in] nodes is the number of inodes to be allocated
+ * @params [out] avail is the number of bytes available
+ * @notes the filesystem of the nearest existing directory is asked and
+ * every node is taken to waste up to a block on top of need; returns
+ * 0 when there is enough room, 1 when there is not and -1 when the
+ * filesystem could not be asked
+ */
+int p_plan_space(int dfd, const char *root, unsigned long long need,
+		unsigned long long nodes, unsigned long long *avail);
+
+/**
+ * @function p_plan_free
+ * @brief function to release a plan
+ * @params [in] pl is a pointer to a struct p_plan instance, may be NULL
+ */
+void p_plan_free(struct p_plan *pl);
+
+#endif
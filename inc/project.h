@@ -8,15 +8,13 @@
 #define PROJECT_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../inc/jsmn.h"
+#include "../inc/mkproject.h"
 
 /* macros */
-#ifndef MAX_ARGS
-#define MAX_ARGS 4
-#endif
-
 #ifndef MIN_ARGS
 #define MIN_ARGS 2
 #endif
@@ -25,10 +23,50 @@
 #define MAXLEN 100
 #endif
 
+#ifndef TOKEN_CHUNK
+#define TOKEN_CHUNK 64
+#endif
+
 #ifndef FLAG_LEN
 #define FLAG_LEN 2
 #endif
 
+#ifndef FLAG_UPDATE
+#define FLAG_UPDATE "--update"
+#endif
+
+#ifndef FLAG_GIT
+#define FLAG_GIT "--git"
+#endif
+
+#ifndef FLAG_RESUME
+#define FLAG_RESUME "--resume"
+#endif
+
+#ifndef FLAG_VERIFY
+#define FLAG_VERIFY "--verify"
+#endif
+
+#ifndef FLAG_DURABLE
+#define FLAG_DURABLE "--durability="
+#endif
+
+#ifndef FLAG_JOBS
+#define FLAG_JOBS "--jobs="
+#endif
+
+#ifndef FLAG_WITH
+#define FLAG_WITH "--with="
+#endif
+
+#ifndef UPDATE_TMP
+#define UPDATE_TMP ".mkp-"
+#endif
+
+#ifndef UPDATE_TMP_TRIES
+#define UPDATE_TMP_TRIES 64
+#endif
+
 #ifndef USER_HOME
 #define USER_HOME "HOME"
 #endif
@@ -53,6 +91,26 @@
 #define CONFIG_FILE "mkpconfig"
 #endif
 
+#ifndef CONFIG_RES_REL
+#define CONFIG_RES_REL "mkproject/res"
+#endif
+
+#ifndef CONFIG_FILE_REL
+#define CONFIG_FILE_REL "mkproject/" CONFIG_FILE
+#endif
+
+#ifndef SYSTEM_RES_DIR
+#define SYSTEM_RES_DIR "/usr/share/mkproject/"
+#endif
+
+#ifndef SYSTEM_DIR_ENV
+#define SYSTEM_DIR_ENV "MKP_SYSTEM_DIR"
+#endif
+
+#ifndef RES_DIR_ENV
+#define RES_DIR_ENV "MKP_RES_DIR"
+#endif
+
 #ifndef CONFIG_DELIM
 #define CONFIG_DELIM "="
 #endif
@@ -73,6 +131,14 @@
 #define TEMPL_BUILD_ID "build_files"
 #endif
 
+#ifndef TEMPL_EXTRA_ID
+#define TEMPL_EXTRA_ID "extras"
+#endif
+
+#ifndef EXTRA_DELIM
+#define EXTRA_DELIM ","
+#endif
+
 #ifndef ROOT_DIR
 #define ROOT_DIR "root"
 #endif
@@ -88,11 +154,59 @@ enum project_t {	/* this might be deprecated later */
 #endif
 
 /* structure */
+struct p_index;
+struct p_hooks;
+struct p_git;
+struct p_durable;
+struct p_dirs;
+struct p_journal;
+struct p_verify;
+struct p_plan;
+
 struct project {
 	int rdp_t;      /* read project type flag */
 	char *pt;	/* project type name - dynamicity is the purpose */
 	char *resd;	/* resource directory location */
+	char *sysd;	/* system wide store beneath resd, NULL if none */
 	char *pdn;	/* project directory name or the project name */
+	int upd;	/* update an existing project - rewrite changed files */
+	struct p_index *idx;	/* resource directory index for patterns */
+	struct p_hooks *hooks;	/* post create hooks of the template */
+	int jobs;	/* maximum number of hooks running at a time */
+	int mkgit;	/* initialize a git repository with the scaffold */
+	struct p_git *git;	/* repository being written, NULL if none */
+	int durable;	/* enum p_durability asked for on the command line */
+	struct p_durable *dur;	/* directories to sync, NULL if none */
+	int dfd;	/* directory pdn is relative to, AT_FDCWD by default */
+	const struct mkp_file *mem;	/* in-memory sources sorted by path,
+					   resd is used if NULL */
+	size_t nmem;	/* number of in-memory sources */
+	struct p_dirs *dirs;	/* directories known to exist below dfd */
+	int resume;	/* skip the files an interrupted run completed */
+	struct p_journal *jrn;	/* journal of completed files, NULL if none */
+	int verify;	/* enum p_verify_mode */
+	struct p_verify *vfy;	/* files to be verified, NULL if none */
+	struct p_plan *plan;	/* resolved template of the run */
+	int rfd;	/* type directory the sources are opened from */
+	int sfd;	/* type directory in sysd, -1 if none */
+	const char *with;	/* comma separated extras of the template,
+				   NULL for none */
+	int fan;	/* the resolved template is kept for further projects */
+	struct p_hooks *hspec;	/* hooks of a kept template, copied into
+				   every project, NULL if none */
+	FILE *out;	/* progress and diagnostics, NULL keeps quiet */
+	int code;	/* enum mkp_status of the first failure */
+	int err;	/* number of failed steps */
+};
+
+struct p_env {
+	const char *home;	/* user home directory */
+	const char *resd;	/* resource directory override, NULL if unset */
+	char *sysd;	/* system wide read-only store, NULL if missing */
+	char *cl;	/* config location - $HOME/.config/mkproject/ */
+	char *rl;	/* default resource location under cl */
+	int cfd;	/* descriptor of $HOME/.config, -1 if missing */
+	bool ready;	/* config and resource directories are in place */
 };
 
 /**
@@ -147,9 +261,14 @@ int p_check_config_dir(const char *cl);
 /**
  * @function p_get_resd_loc
  * @brief function to get the resource directory location
+ * @params [in] e is a pointer to the resolved environment
  * @params [in] p is a pointer to a struct project instance
+ * @notes $MKP_RES_DIR takes precedence over the configuration file. With a
+ * system wide store and no configuration file, $HOME/.config/mkproject/res
+ * is the optional layer of overrides and nothing is created; returns 0 on
+ * success and 1 when the configuration file holds no location
  */
-int p_get_resd_loc(struct project * restrict p);
+int p_get_resd_loc(struct p_env * restrict e, struct project * restrict p);
 
 /**
  * @function p_strsplice
@@ -180,6 +299,15 @@ void p_parse_jsdata(const char *jsd, struct project * restrict p);
  */
 int p_jsoneq(const char *json, jsmntok_t *tok, const char *s);
 
+/**
+ * @function p_skip_token
+ * @brief function to return the index of the token following the subtree
+ * rooted at token i
+ * @params [in] t are the tokens returned by the JSMN parser
+ * @params [in] i is the index of the root of the subtree
+ */
+int p_skip_token(const jsmntok_t *t, int i);
+
 /**
  * @function p_get_tokenc
  * @brief function to return the number of tokens found by the JSMN parser
@@ -193,12 +321,17 @@ int p_get_tokenc(const char *s);
  * @brief function to copy the filename provided from source to destination
  * @params [in] src is the source filepath
  * @params [in] dest is the destination filepath
+ * @params [in] p is a pointer to the project structure instance/object
+ * @notes in update mode an unchanged destination is left untouched and a
+ * changed one is replaced atomically; src is relative to p->rfd, which is
+ * AT_FDCWD outside of a run, and dest is relative to p->dfd
  */
-void p_copy_file(const char *src, const char *dest);
+void p_copy_file(const char *src, const char *dest,
+                struct project * restrict p);
 
 /**
  * @function p_process_bdirs
- * @brief function to create the directories from the configuration
+ * @brief function to add the directories of the configuration to the plan
  * @params [in] s is the string containing the names of the directories
  * @params [in] p is a pointer to the project structure instance/object
  */
@@ -206,12 +339,24 @@ int p_process_bdirs(const char *s, struct project * restrict p);
 
 /**
  * @function p_process_bfiles
- * @brief function to copy the respective files from the configuration
+ * @brief function to add the files of the configuration to the plan, with
+ * the patterns expanded
  * @params [in] s is the string containing the names of the directories
  * @params [in] p is a pointer to the project structure instance/object
  */
 int p_process_bfiles(const char *s, struct project * restrict p);
 
+/**
+ * @function p_process_extras
+ * @brief function to add the extras asked for in p->with to the plan
+ * @params [in] s is the string containing the extras object of the template,
+ * NULL if the template has none
+ * @params [in] p is a pointer to the project structure instance/object
+ * @notes every extra has dirs and build_files of its own, in the format of
+ * the template itself; an extra the template does not have fails the run
+ */
+int p_process_extras(const char *s, struct project * restrict p);
+
 /**
  * @function p_read_template
  * @brief function to read the template file
@@ -226,17 +371,59 @@ void p_read_template(struct project * restrict p);
  */
 void p_mkproject(struct project * restrict p);
 
+/**
+ * @function p_mkprojects
+ * @brief function to create the same project in several directories
+ * @params [in] p is a pointer to a struct project instance
+ * @params [in] names are the project directories
+ * @params [in] n is the number of project directories
+ * @notes the template is read and resolved once and every source file is
+ * mapped into memory once, then written from there into each project -
+ * the reads of the template do not grow with the number of projects. A
+ * failed project does not stop the rest; every project runs its own hooks
+ * and is verified against the template
+ */
+void p_mkprojects(struct project * restrict p, char * const *names, int n);
+
 /**
  * @function check_parent_dir
  * @brief function to check the parent directory which will be housing the
  * mkproject configuration file
+ * @params [in] e is a pointer to the resolved environment
  */
-void p_check_parent_dir(void);
+void p_check_parent_dir(struct p_env * restrict e);
 
 /**
  * @function p_copy_resources
  * @brief function to copy the resource directory to the config location
+ * @params [in] e is a pointer to the resolved environment
+ */
+void p_copy_resources(const struct p_env * restrict e);
+
+/**
+ * @function p_system_dir
+ * @brief function to find the system wide store
+ * @notes $MKP_SYSTEM_DIR or /usr/share/mkproject, with a trailing '/';
+ * returns NULL if it is not a directory or on allocation failure, the
+ * result is freed by the caller
+ */
+char *p_system_dir(void);
+
+/**
+ * @function p_env_init
+ * @brief function to resolve the environment once for the whole run
+ * @params [in] e is a pointer to a struct p_env instance
+ * @notes the bootstrap state is probed with a single fstatat against
+ * $HOME/.config, so a configured setup needs no further checks; the system
+ * wide store is $MKP_SYSTEM_DIR or /usr/share/mkproject
+ */
+int p_env_init(struct p_env * restrict e);
+
+/**
+ * @function p_env_free
+ * @brief function to release the resources held by the environment
+ * @params [in] e is a pointer to a struct p_env instance
  */
-void p_copy_resources(void);
+void p_env_free(struct p_env * restrict e);
 
 #endif
@@ -0,0 +1,62 @@
+/**
+ * @file 	sha1.h
+ * @author 	sb
+ * @brief 	SHA-1 as used for git object names
+ */
+
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* macros */
+#ifndef SHA1_LEN
+#define SHA1_LEN 20
+#endif
+
+#ifndef SHA1_HEX_LEN
+#define SHA1_HEX_LEN 40
+#endif
+
+/* structure */
+struct p_sha1 {
+	uint32_t h[5];		/* intermediate digest */
+	uint64_t total;		/* number of bytes consumed */
+	unsigned char blk[64];	/* bytes waiting for a full block */
+	size_t blksz;		/* number of bytes held in blk */
+};
+
+/**
+ * @function p_sha1_init
+ * @brief function to initialize a SHA-1 state
+ * @params [in] s is a pointer to a struct p_sha1 instance
+ */
+void p_sha1_init(struct p_sha1 *s);
+
+/**
+ * @function p_sha1_update
+ * @brief function to feed data into a SHA-1 state
+ * @params [in] s is a pointer to a struct p_sha1 instance
+ * @params [in] d is the data to be hashed
+ * @params [in] n is the number of bytes in d
+ */
+void p_sha1_update(struct p_sha1 *s, const void *d, size_t n);
+
+/**
+ * @function p_sha1_final
+ * @brief function to finish the hash and store the digest
+ * @params [in] s is a pointer to a struct p_sha1 instance
+ * @params [out] md is a buffer of SHA1_LEN bytes
+ */
+void p_sha1_final(struct p_sha1 *s, unsigned char *md);
+
+/**
+ * @function p_sha1_hex
+ * @brief function to format a digest as a hex string
+ * @params [in] md is the digest of SHA1_LEN bytes
+ * @params [out] s is a buffer of at least SHA1_HEX_LEN + 1 bytes
+ */
+void p_sha1_hex(const unsigned char *md, char *s);
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file 	store.h
+ * @author 	sb
+ * @brief 	content addressed object store backing the resource directory
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../inc/hash.h"
+
+/* macros */
+#ifndef STORE_DIR
+#define STORE_DIR ".objects/"
+#endif
+
+#ifndef STORE_TMP
+#define STORE_TMP ".tmp-XXXXXX"
+#endif
+
+/* modification time every object carries, in seconds since the epoch */
+#ifndef STORE_MTIME
+#define STORE_MTIME 0
+#endif
+
+/**
+ * @function p_store_put
+ * @brief function to add a file to the object store, keyed by its hash
+ * @params [in] objd is the path of the object directory (with trailing /)
+ * @params [in] src is the path of the file to be stored
+ * @params [out] hex is a buffer of HASH_HEX_LEN + 1 bytes for the key
+ * @notes returns 0 on success and 1 on failure; content already present in
+ * the store is not written again; objects are read-only and carry
+ * STORE_MTIME, so a template file is never edited through a shared inode
+ */
+int p_store_put(const char *objd, const char *src, char *hex);
+
+/**
+ * @function p_store_link
+ * @brief function to make dest refer to a stored object
+ * @params [in] objd is the path of the object directory (with trailing /)
+ * @params [in] hex is the key of the object
+ * @params [in] dest is the path which should refer to the object
+ * @notes a hardlink is used when possible and a read-only copy otherwise;
+ * returns 0 on success and 1 on failure
+ */
+int p_store_link(const char *objd, const char *hex, const char *dest);
+
+/**
+ * @function p_store_sealed
+ * @brief function to check that a stored object is unchanged since stored
+ * @params [in] s is the status of the object
+ * @notes returns 1 when the object is read-only and still has STORE_MTIME,
+ * so its name can be trusted for its content, and 0 otherwise
+ */
+int p_store_sealed(const struct stat *s);
+
+/**
+ * @function p_store_mode
+ * @brief function to give the permissions of a file written from a template
+ * @params [in] m is the mode of the template file
+ * @notes template files are read-only objects, a copy is writable again
+ */
+mode_t p_store_mode(mode_t m);
+
+/**
+ * @function p_store_clone
+ * @brief function to reflink the whole of sfd into dfd
+ * @params [in] sfd is the source file descriptor
+ * @params [in] dfd is the destination file descriptor
+ * @notes returns 0 when the blocks are now shared, -1 when the filesystem
+ * does not support it and the caller has to copy
+ */
+int p_store_clone(int sfd, int dfd);
+
+/**
+ * @function p_store_copy_fd
+ * @brief function to copy n bytes from sfd to dfd inside the kernel
+ * @params [in] sfd is the source file descriptor
+ * @params [in] dfd is the destination file descriptor
+ * @params [in] n is the number of bytes to be copied
+ */
+int p_store_copy_fd(int sfd, int dfd, off_t n);
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file 	verify.h
+ * @author 	sb
+ * @brief 	check of a materialized project against its template, --verify
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* macros */
+#ifndef VERIFY_CHUNK
+#define VERIFY_CHUNK 64
+#endif
+
+/* enum */
+enum p_verify_mode {
+	VERIFY_NONE,	/* nothing is checked */
+	VERIFY_AFTER,	/* the files are checked once they are written */
+	VERIFY_ONLY	/* an existing project is checked, nothing is written */
+};
+
+enum p_verify_state {
+	VERIFY_SAME,	/* the file has the content of the template */
+	VERIFY_DIFFER,	/* the content differs */
+	VERIFY_MISSING,	/* the file is not in the project */
+	VERIFY_EREAD,	/* the file could not be read */
+	VERIFY_ESOURCE	/* the file of the template could not be read */
+};
+
+/* structure */
+struct p_vent {
+	char *dest;		/* path of the file, relative to dfd */
+	char *src;		/* path of the template file, NULL for a buffer */
+	const void *d;		/* contents of an in-memory template file */
+	size_t n;
+	int state;		/* enum p_verify_state, set by p_verify_run */
+	int err;		/* errno of VERIFY_EREAD and VERIFY_ESOURCE */
+};
+
+struct p_verify {
+	int dfd;		/* directory the destinations are relative to */
+	char *objd;		/* object store of the resource directory */
+	struct p_vent *e;	/* files in template order */
+	size_t n;
+	size_t cap;
+};
+
+/**
+ * @function p_verify_init
+ * @brief function to start the list of files to be verified
+ * @params [in] v is a pointer to a struct p_verify instance
+ * @params [in] dfd is the directory the destinations are relative to
+ * @params [in] resd is the resource directory, NULL for in-memory templates
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_verify_init(struct p_verify *v, int dfd, const char *resd);
+
+/**
+ * @function p_verify_add
+ * @brief function to add a file of the template to the list
+ * @params [in] v is a pointer to a struct p_verify instance
+ * @params [in] dest is the path of the file in the project
+ * @params [in] src is the path of the template file, or NULL
+ * @params [in] d are the contents when src is NULL, kept by reference
+ * @params [in] n is the number of bytes in d
+ * @notes returns 0 on success and 1 on failure
+ */
+int p_verify_add(struct p_verify *v, const char *dest, const char *src,
+		const void *d, size_t n);
+
+/**
+ * @function p_verify_run
+ * @brief function to compare every listed file with its template file
+ * @params [in] v is a pointer to a struct p_verify instance
+ * @params [in] jobs is the maximum number of threads hashing at a time
+ * @notes a template file which is a sealed object of the store is known by
+ * the name of the object and is not read; everything else is hashed with XXH64,
+ * files of different size are not read at all. The state of every entry is
+ * set. The calling thread takes part, so the check completes even when no
+ * thread can be started
+ */
+void p_verify_run(struct p_verify *v, int jobs);
+
+/**
+ * @function p_verify_free
+ * @brief function to release the list
+ * @params [in] v is a pointer to a struct p_verify instance, may be NULL
+ */
+void p_verify_free(struct p_verify *v);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * implementation of the runner declared in bench.h - the timings are taken
+ * with the monotonic clock, the cycles with a hardware counter through
+ * perf_event_open or else the time stamp counter, and the process is
+ * pinned to one cpu, wherever the system offers these
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench/bench.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* counter of the run, opened once */
+struct bench_ctr {
+	const char *kind;	/* "cycles", "tsc" or NULL for none */
+	int fd;			/* perf event, -1 if not used */
+};
+
+static unsigned long bench_env(const char *name, unsigned long def)
+{
+	const char *v = getenv(name);
+	char *e = NULL;
+	if (!v || !*v)
+		return def;
+	unsigned long r = strtoul(v, &e, 10);
+	return *e ? def : r;
+}
+
+static int bench_pin(int cpu)
+{
+#if defined(__linux__)
+	if (cpu < 0)
+		return -1;
+	cpu_set_t s;
+	CPU_ZERO(&s);
+	CPU_SET(cpu, &s);
+	return sched_setaffinity(0, sizeof(s), &s) == 0 ? cpu : -1;
+#else
+	(void)cpu;
+	return -1;
+#endif
+}
+
+static void bench_ctr_open(struct bench_ctr *c)
+{
+	c->kind = NULL;
+	c->fd = -1;
+#if defined(__linux__)
+	struct perf_event_attr a;
+	memset(&a, 0, sizeof(a));
+	a.size = sizeof(a);
+	a.type = PERF_TYPE_HARDWARE;
+	a.config = PERF_COUNT_HW_CPU_CYCLES;
+	a.exclude_kernel = 1;
+	a.exclude_hv = 1;
+	c->fd = (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+	if (c->fd != -1) {
+		c->kind = "cycles";
+		return;
+	}
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	c->kind = "tsc";
+#endif
+}
+
+static uint64_t bench_ctr_read(const struct bench_ctr *c)
+{
+	if (c->fd != -1) {
+		uint64_t v = 0;
+		return read(c->fd, &v, sizeof(v)) == sizeof(v) ? v : 0;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	if (c->kind)
+		return __rdtsc();
+#endif
+	return 0;
+}
+
+static double bench_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* v is sorted, q in [0, 1] - the nearest rank */
+static double bench_rank(const double *v, size_t n, double q)
+{
+	size_t i = (size_t)(q * n + 0.999999);
+	return v[i ? i - 1 : 0];
+}
+
+static int bench_wanted(const char *name, int argc, char **argv)
+{
+	if (argc < 2)
+		return 1;
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(name, argv[i]))
+			return 1;
+	return 0;
+}
+
+static void bench_one(const struct bench_case *c, const struct bench_opts *o,
+		const struct bench_ctr *k, double *t, double *y, int first)
+{
+	for (unsigned r = 0; r < o->warmup; r++)
+		for (unsigned long i = 0; i < o->iters; i++)
+			c->fn(c->arg);
+
+	for (unsigned r = 0; r < o->reps; r++) {
+		uint64_t y0 = bench_ctr_read(k);
+		double t0 = bench_now();
+		for (unsigned long i = 0; i < o->iters; i++)
+			c->fn(c->arg);
+		double t1 = bench_now();
+		uint64_t y1 = bench_ctr_read(k);
+		t[r] = (t1 - t0) / o->iters;
+		y[r] = (double)(y1 - y0) / o->iters;
+	}
+
+	qsort(t, o->reps, sizeof(double), bench_cmp);
+	qsort(y, o->reps, sizeof(double), bench_cmp);
+
+	printf("%s\n  {\"name\": \"%s\", \"warmup\": %u, \"reps\": %u, "
+			"\"iters\": %lu, \"cpu\": %d, \"median_ns\": %.3f, "
+			"\"p99_ns\": %.3f, \"min_ns\": %.3f, ", first ? "" : ",",
+			c->name, o->warmup, o->reps, o->iters, o->cpu,
+			bench_rank(t, o->reps, 0.5), bench_rank(t, o->reps, 0.99),
+			t[0]);
+	if (k->kind)
+		printf("\"counter\": \"%s\", \"median_counter\": %.3f, "
+				"\"p99_counter\": %.3f}", k->kind,
+				bench_rank(y, o->reps, 0.5),
+				bench_rank(y, o->reps, 0.99));
+	else
+		printf("\"counter\": null, \"median_counter\": null, "
+				"\"p99_counter\": null}");
+}
+
+int bench_main(const struct bench_case *c, size_t n, int argc, char **argv)
+{
+	struct bench_opts o;
+	o.warmup = (unsigned)bench_env("BENCH_WARMUP", 10);
+	o.reps = (unsigned)bench_env("BENCH_REPS", 100);
+	o.iters = bench_env("BENCH_ITERS", 1000);
+	o.cpu = -1;
+	if (!o.reps || !o.iters) {
+		fprintf(stderr, "BENCH_REPS and BENCH_ITERS have to be "
+				"positive\n");
+		return 1;
+	}
+
+	/* the cpu the run started on unless one is asked for, BENCH_CPU=-1
+	 * leaves the scheduler free to move it */
+	const char *pc = getenv("BENCH_CPU");
+#if defined(__linux__)
+	o.cpu = pc && *pc ? atoi(pc) : sched_getcpu();
+#else
+	o.cpu = pc && *pc ? atoi(pc) : -1;
+#endif
+	o.cpu = bench_pin(o.cpu);
+
+	struct bench_ctr k;
+	bench_ctr_open(&k);
+
+	double *t = (double *)malloc(o.reps * sizeof(double));
+	double *y = (double *)malloc(o.reps * sizeof(double));
+	if (!t || !y) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		free(t);
+		free(y);
+		return 1;
+	}
+
+	size_t ran = 0;
+	printf("[");
+	for (size_t i = 0; i < n; i++) {
+		if (!bench_wanted(c[i].name, argc, argv))
+			continue;
+		bench_one(&c[i], &o, &k, t, y, !ran);
+		fflush(stdout);
+		ran++;
+	}
+	printf("\n]\n");
+
+	free(t);
+	free(y);
+	if (k.fd != -1)
+		close(k.fd);
+
+	/* a name which matched no case is a mistake worth failing on */
+	if (argc > 1 && ran < (size_t)(argc - 1)) {
+		fprintf(stderr, "Some of the cases asked for do not exist\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,26 @@
+/*
+ * benchmark cases of the project - add a function and an entry to cases,
+ * the sources in src/ apart from main are linked in
+ */
+
+#include "bench/bench.h"
+
+static void bench_sum(void *arg)
+{
+	static unsigned v[1024];
+	unsigned s = 0;
+	bench_escape(v);
+	for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); i++)
+		s += v[i] + (unsigned)i;
+	bench_escape(&s);
+	(void)arg;
+}
+
+static const struct bench_case cases[] = {
+	{ "sum_1k", bench_sum, NULL },
+};
+
+int main(int argc, char **argv)
+{
+	return bench_main(cases, sizeof(cases) / sizeof(cases[0]), argc, argv);
+}
@@ -1,9 +1,11 @@
 #!/usr/bin/env python3
 
 from pathlib import Path
-from os import sep, getcwd, system
-from sys import exit
+from os import sep, getcwd, cpu_count, access, X_OK
+from sys import argv, exit
 from json import dump, load
+from subprocess import run
+from time import monotonic, strftime
 
 BUILD_ICON = "\U0001F528"
 ERROR_ICON = "\U0001F626"
@@ -11,35 +13,48 @@ PASS_ICON = "\U0001F60E"
 FILE_ICON = "\U0001F4C4"
 EDIT_ICON = "\U0001F589"
 GEAR_ICON = "\U00002699"
+CLOCK_ICON = "\U000023F1"
+
+# builds kept in .version_info.json, the oldest are dropped past it
+BUILD_HISTORY = 1000
 
 def update_build_info(major: int = 0, minor: int = 0, build_number: int = 1) -> None:
-	with open(f"{getcwd()}{sep}inc/buildinfo.h", "w") as binfo_file:
-		# write the header guard first
-		binfo_file.write("#ifndef BUILDINFO_H\n")
-		binfo_file.write("#define BUILDINFO_H\n\n")
-
-		# add the details of the build information
-		print(f"{EDIT_ICON} : Updating major value : {major}")
-		binfo_file.write("#ifndef MAJOR\n")
-		binfo_file.write(f"\t#define MAJOR {major}\n")
-		binfo_file.write("#endif\n\n")
-		print(f"{EDIT_ICON} : Updating minor value : {minor}")
-		binfo_file.write("#ifndef MINOR\n")
-		binfo_file.write(f"\t#define MINOR {minor}\n")
-		binfo_file.write("#endif\n\n")
-		print(f"{EDIT_ICON} : Updating build number value : {build_number}")
-		binfo_file.write("#ifndef BUILD_NUMBER\n")
-		binfo_file.write(f"\t#define BUILD_NUMBER {build_number}\n")
-		binfo_file.write("#endif\n\n")
-
-		# write the header guard completion
-		binfo_file.write("#endif")
-
-
-def store_version_info(major: int, minor: int, build_number: int) -> None:
-	data = {"major": major, "minor": minor, "build_number": build_number}
+	# write the header guard first
+	info = "#ifndef BUILDINFO_H\n"
+	info += "#define BUILDINFO_H\n\n"
+
+	# add the details of the build information
+	info += "#ifndef MAJOR\n"
+	info += f"\t#define MAJOR {major}\n"
+	info += "#endif\n\n"
+	info += "#ifndef MINOR\n"
+	info += f"\t#define MINOR {minor}\n"
+	info += "#endif\n\n"
+	info += "#ifndef BUILD_NUMBER\n"
+	info += f"\t#define BUILD_NUMBER {build_number}\n"
+	info += "#endif\n\n"
+
+	# write the header guard completion
+	info += "#endif"
+
+	# everything including the header is recompiled when it is written, so
+	# the same values leave the file and its timestamp alone
+	binfo = Path(f"{getcwd()}{sep}inc{sep}buildinfo.h")
+	if binfo.exists() and binfo.read_text() == info:
+		print(f"{EDIT_ICON} : Build information is unchanged : {major}.{minor}.{build_number}")
+		return
+
+	print(f"{EDIT_ICON} : Updating major value : {major}")
+	print(f"{EDIT_ICON} : Updating minor value : {minor}")
+	print(f"{EDIT_ICON} : Updating build number value : {build_number}")
+	binfo.write_text(info)
+
+
+def store_version_info(major: int, minor: int, build_number: int, builds: list = None) -> None:
+	data = {"major": major, "minor": minor, "build_number": build_number,
+		"builds": (builds or [])[-BUILD_HISTORY:]}
 	with open(f"{getcwd()}{sep}.version_info.json", "w") as version_info_file:
-		dump(data, version_info_file)
+		dump(data, version_info_file, indent=1)
 
 
 def read_version_info() -> dict:
@@ -48,12 +63,44 @@ def read_version_info() -> dict:
 
 	return data
 
-def make_project() -> None:
-	system("make")
+def build_jobs() -> int:
+	# the CPUs this process may run on, which a container or taskset can
+	# limit below the number the machine has
+	try:
+		from os import sched_getaffinity
+		return len(sched_getaffinity(0))
+	except (ImportError, OSError):
+		return cpu_count() or 1
+
+def next_version(major: int, minor: int, build_number: int) -> (int, int, int):
+	if build_number < 2600:
+		return major, minor, build_number + 1
+	if minor >= 100:
+		return major + 1, 0, 1
+	return major, minor + 1, 1
+
+def linked_outputs() -> dict:
+	# every executable below build/ with its time - a build which linked
+	# anything again changes one of them, one with nothing to do none
+	root = Path(f"{getcwd()}{sep}build")
+	if not root.is_dir():
+		return {}
+	return {str(p): p.stat().st_mtime_ns for p in root.rglob("*")
+		if p.is_file() and access(p, X_OK)}
+
+def make_project(target: str) -> (int, float):
+	jobs = build_jobs()
+	print(f"{GEAR_ICON} : Running make {target} on {jobs} jobs\n")
+
+	start = monotonic()
+	status = run(["make", f"-j{jobs}", target]).returncode
+	return status, monotonic() - start
 
 
 def main() -> None:
 	major, minor, build_number = 0, 0, 1
+	builds = []
+	target = argv[1] if len(argv) > 1 else "all"
 	print(f"{GEAR_ICON} : Building project - {str(Path(__file__).resolve()).split(sep)[-2]}\n")
 
 	if not Path(f"{getcwd()}{sep}Makefile").exists():
@@ -65,41 +112,46 @@ def main() -> None:
 		print(f"{PASS_ICON} : Makefile found\n")
 
 		# check if the header file is present or not for capturing version information
-		if not Path(f"{getcwd()}{sep}inc{sep}buildinfo.h").exists():
+		fresh = not Path(f"{getcwd()}{sep}inc{sep}buildinfo.h").exists()
+		if fresh:
 			print(f"{FILE_ICON} : buildinfo header file is not present - creating it")
 			update_build_info()
-			store_version_info(major=major, minor=minor, build_number=build_number)
-
-			print(f"\n{BUILD_ICON} : Building project ...\n")
-			make_project()
 		else:
-			# if the file is present, read the file and update the values before incrementing the build number
-			print(f"{FILE_ICON} : buildinfo header file is present - updating it")
-			print(f"{GEAR_ICON} : Updating build versions")
+			# if the file is present, the build number of the last build is read back
+			print(f"{FILE_ICON} : buildinfo header file is present - reading it")
 
 			data = read_version_info()
 			major = data["major"]
 			minor = data["minor"]
 			build_number = data["build_number"]
-
-			if build_number >= 2600:
-				build_number = 1
-				if minor >= 100:
-					major += 1
-					minor = 0
-				else:
-					minor += 1
-			else:
-				build_number += 1
-
+			builds = data.get("builds", [])
+
+		print(f"\n{BUILD_ICON} : Building project ...\n")
+		before = linked_outputs()
+		status, seconds = make_project(target)
+
+		# the number only moves for a build which linked something again,
+		# and then the files including the header are built once more -
+		# a build with nothing to do leaves the header, and everything
+		# depending on it, alone
+		if status != 0:
+			print(f"\n{ERROR_ICON} : Build failed with status {status}")
+		elif not fresh and linked_outputs() != before:
+			print(f"\n{GEAR_ICON} : Outputs were linked again - updating build versions")
+			major, minor, build_number = next_version(major, minor, build_number)
 			update_build_info(major=major, minor=minor, build_number=build_number)
-			store_version_info(major=major, minor=minor, build_number=build_number)
-
-			print(f"\n{BUILD_ICON} : Building project ...\n")
-			make_project()
+			status, more = make_project(target)
+			seconds += more
+			if status != 0:
+				print(f"\n{ERROR_ICON} : Build failed with status {status}")
+
+		builds.append({"target": target, "seconds": round(seconds, 3),
+			"status": status, "date": strftime("%Y-%m-%dT%H:%M:%S%z")})
+		store_version_info(major=major, minor=minor, build_number=build_number, builds=builds)
+		print(f"\n{CLOCK_ICON} : {target} took {seconds:.3f}s")
 		print()
 
-	exit(0)
+	exit(status)
 
 if __name__ == "__main__":
 	main()
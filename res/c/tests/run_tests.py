@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+
+from pathlib import Path
+from os import access, cpu_count, environ, getcwd, sep, X_OK
+from sys import argv, exit
+from json import dump, load
+from subprocess import run, PIPE, STDOUT, TimeoutExpired
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from time import monotonic
+from xml.sax.saxutils import escape, quoteattr
+
+PASS_ICON = "\U0001F60E"
+ERROR_ICON = "\U0001F626"
+CLOCK_ICON = "\U000023F1"
+GEAR_ICON = "\U00002699"
+
+# durations of earlier runs, kept next to .version_info.json so that make
+# clean does not forget them
+DURATIONS_FILE = ".test_durations.json"
+
+def env_int(name: str, default: int) -> int:
+	try:
+		return int(environ.get(name, "") or default)
+	except ValueError:
+		print(f"{ERROR_ICON} : {name} has to be a number")
+		exit(2)
+
+def test_jobs() -> int:
+	try:
+		from os import sched_getaffinity
+		return len(sched_getaffinity(0))
+	except (ImportError, OSError):
+		return cpu_count() or 1
+
+def discover(paths: list) -> dict:
+	# the test binaries are named by make, a directory stands for every
+	# executable file in it; a test passes when it exits with 0
+	tests = {}
+	for a in map(Path, paths):
+		found = a.iterdir() if a.is_dir() else [a]
+		for p in found:
+			if p.is_file() and p.suffix not in (".o", ".d") and access(p, X_OK):
+				tests[p.name] = p
+			elif not a.is_dir():
+				print(f"{ERROR_ICON} : {p} is not an executable")
+				exit(2)
+
+	return tests
+
+def read_durations() -> dict:
+	path = Path(f"{getcwd()}{sep}{DURATIONS_FILE}")
+	if not path.exists():
+		return {}
+	with open(path) as durations_file:
+		return load(durations_file)
+
+def store_durations(durations: dict) -> None:
+	with open(f"{getcwd()}{sep}{DURATIONS_FILE}", "w") as durations_file:
+		dump(durations, durations_file, indent=1, sort_keys=True)
+
+def schedule(tests: list, durations: dict, index: int, total: int) -> list:
+	# slowest first, a test without a duration is taken to be as slow as
+	# the slowest one. The tests are dealt to the shards greedily, each to
+	# the one with the least work so far - every node computes the same
+	# split from the same durations
+	slowest = max(durations.values(), default=1.0)
+	order = sorted(tests, key=lambda t: (-durations.get(t, slowest), t))
+	load_of = [0.0] * total
+	shards = [[] for _ in range(total)]
+	for t in order:
+		s = load_of.index(min(load_of))
+		shards[s].append(t)
+		load_of[s] += durations.get(t, slowest)
+
+	return shards[index]
+
+def run_test(path: Path, timeout: int) -> dict:
+	start = monotonic()
+	try:
+		r = run([str(path)], stdout=PIPE, stderr=STDOUT,
+			timeout=timeout or None)
+		status, output = r.returncode, r.stdout
+	except TimeoutExpired as e:
+		status, output = None, e.stdout or b""
+
+	return {"name": path.name, "status": status, "seconds": monotonic() - start,
+		"output": output.decode(errors="replace")}
+
+def write_junit(path: str, suite: str, results: list, seconds: float) -> None:
+	failures = sum(1 for r in results if r["status"] not in (0, None))
+	errors = sum(1 for r in results if r["status"] is None)
+	with open(path, "w") as xml_file:
+		xml_file.write('<?xml version="1.0" encoding="UTF-8"?>\n')
+		xml_file.write(f'<testsuite name={quoteattr(suite)} tests="{len(results)}" '
+			f'failures="{failures}" errors="{errors}" time="{seconds:.3f}">\n')
+		for r in results:
+			xml_file.write(f'\t<testcase classname={quoteattr(suite)} '
+				f'name={quoteattr(r["name"])} time="{r["seconds"]:.3f}">\n')
+			if r["status"] is None:
+				xml_file.write('\t\t<error message="timed out"/>\n')
+			elif r["status"] != 0:
+				xml_file.write(f'\t\t<failure message="exit status {r["status"]}"/>\n')
+			if r["output"]:
+				xml_file.write(f'\t\t<system-out>{escape(r["output"])}</system-out>\n')
+			xml_file.write('\t</testcase>\n')
+		xml_file.write('</testsuite>\n')
+
+def main() -> None:
+	if len(argv) < 2:
+		print(f"{ERROR_ICON} : Usage - {argv[0]} <test binary or directory>...")
+		exit(2)
+
+	found = discover(argv[1:])
+	test_dir = next(iter(found.values())).parent if found else Path(getcwd())
+	jobs = env_int("TEST_JOBS", test_jobs())
+	index = env_int("TEST_SHARD_INDEX", 0)
+	total = env_int("TEST_TOTAL_SHARDS", 1)
+	timeout = env_int("TEST_TIMEOUT", 300)
+	junit = environ.get("TEST_XML", str(test_dir / "results.xml"))
+	if jobs < 1 or total < 1 or not 0 <= index < total:
+		print(f"{ERROR_ICON} : TEST_JOBS, TEST_SHARD_INDEX or TEST_TOTAL_SHARDS is out of range")
+		exit(2)
+
+	# tests which are gone are forgotten
+	durations = {t: d for t, d in read_durations().items() if t in found}
+	tests = schedule(sorted(found), durations, index, total)
+	print(f"{GEAR_ICON} : Running {len(tests)} tests of shard {index + 1}/{total} on {jobs} jobs\n")
+
+	# the pool takes the tests in the order they are submitted, so the
+	# slowest start first and the short ones fill the gaps at the end
+	results = []
+	start = monotonic()
+	with ThreadPoolExecutor(max_workers=jobs) as pool:
+		pending = [pool.submit(run_test, found[t], timeout) for t in tests]
+		for f in as_completed(pending):
+			r = f.result()
+			results.append(r)
+			if r["status"] == 0:
+				print(f"{PASS_ICON} : PASS {r['name']} ({r['seconds']:.3f}s)")
+			else:
+				state = "TIMEOUT" if r["status"] is None else f"FAIL ({r['status']})"
+				print(f"{ERROR_ICON} : {state} {r['name']} ({r['seconds']:.3f}s)")
+				print(r["output"], end="" if r["output"].endswith("\n") else "\n")
+	seconds = monotonic() - start
+
+	results.sort(key=lambda r: r["name"])
+	write_junit(junit, test_dir.parent.name, results, seconds)
+	durations.update({r["name"]: round(r["seconds"], 3) for r in results})
+	store_durations(durations)
+
+	failed = [r["name"] for r in results if r["status"] != 0]
+	print(f"\n{CLOCK_ICON} : {len(results) - len(failed)}/{len(results)} passed in {seconds:.3f}s, results in {junit}")
+	exit(1 if failed else 0)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,51 @@
+/*
+ * microbenchmark runner - every case is warmed up, then timed over a number
+ * of repetitions of a batch of calls, and the median and p99 per call are
+ * printed as JSON. Built with the release flags by `make bench`
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a case is one call of fn, arg is passed through untouched */
+typedef void (*bench_fn)(void *arg);
+
+struct bench_case {
+	const char *name;
+	bench_fn fn;
+	void *arg;
+};
+
+/* defaults, each of them can be overridden from the environment */
+struct bench_opts {
+	unsigned warmup;	/* BENCH_WARMUP - repetitions thrown away */
+	unsigned reps;		/* BENCH_REPS - repetitions measured */
+	unsigned long iters;	/* BENCH_ITERS - calls per repetition */
+	int cpu;		/* BENCH_CPU - cpu to pin to, -1 for none */
+};
+
+/* keeps the compiler from optimizing away a result or a store to p */
+static inline void bench_escape(void *p)
+{
+#if defined(__GNUC__)
+	__asm__ __volatile__("" : : "g"(p) : "memory");
+#else
+	(void)p;
+#endif
+}
+
+/* runs the cases named in argv, or all of them, and prints a JSON array
+ * to stdout; returns the exit status of the program */
+int bench_main(const struct bench_case *c, size_t n, int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * precompiled header, built once per configuration with `make PCH=1` and
+ * included ahead of every translation unit - keep it to headers which are
+ * stable and used widely, a change to it rebuilds everything
+ */
+
+#ifndef PCH_HPP
+#define PCH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * every file in tests/ is a test program of its own, linked with the
+ * sources apart from main - it passes when it exits with 0
+ */
+
+#include <cstdio>
+
+#define CHECK(c) do { if (!(c)) { std::fprintf(stderr, "%s:%d: CHECK(%s) " \
+		"failed\n", __FILE__, __LINE__, #c); return 1; } } while (0)
+
+int main()
+{
+	CHECK(1 + 1 == 2);
+	return 0;
+}
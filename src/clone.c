@@ -0,0 +1,143 @@
+/*
+ * @file 	clone.c
+ * @author 	sb
+ * @brief 	source file for clone header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../inc/clone.h"
+#include "../inc/store.h"
+
+/* structure */
+struct p_crun {
+        struct p_cjob *j;
+        size_t n;
+        int dfd;
+        const struct p_durable *dur;    /* sync of every file, may be NULL */
+        atomic_size_t next;     /* next file to be taken by a thread */
+        p_clone_fn done;        /* reports a finished file, may be NULL */
+        void *arg;
+        pthread_mutex_t lock;   /* serializes the calls of done */
+};
+
+/* static utility functions */
+static int p_clone_buf(int fd, const char *d, size_t n)
+{
+        while (n) {
+                ssize_t r = write(fd, d, n);
+                if (r == -1 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return -1;
+                d += r;
+                n -= r;
+        }
+
+        return 0;
+}
+
+static void p_clone_one(const struct p_crun *r, struct p_cjob *j)
+{
+        int sfd = -1;
+        if (j->src && ((sfd = openat(j->rfd, j->src,
+                                                O_RDONLY | O_CLOEXEC)) == -1 ||
+                                fstat(sfd, &j->st) == -1)) {
+                j->serr = errno;
+                if (sfd != -1)
+                        close(sfd);
+                return;
+        }
+        if (!j->src)
+                j->st.st_mode = j->mode;
+
+        int fd = openat(r->dfd, j->dest, O_WRONLY | O_CLOEXEC | O_CREAT |
+                        O_TRUNC, 0666);
+        if (fd == -1) {
+                j->derr = errno;
+                if (sfd != -1)
+                        close(sfd);
+                return;
+        }
+        (void)fchmod(fd, p_store_mode(j->st.st_mode));
+
+        /* blocks are shared on a CoW filesystem, so the whole tree costs
+         * little more than its metadata there */
+        int w = 0;
+        if (sfd == -1) {
+                w = p_clone_buf(fd, j->d, j->st.st_size);
+        } else if (p_store_clone(sfd, fd) == -1) {
+                errno = 0;
+                w = p_store_copy_fd(sfd, fd, j->st.st_size);
+        }
+        if (w == -1)
+                j->derr = errno ? errno : EIO;
+        errno = 0;
+        if (!j->derr && p_durable_sync(r->dur, fd))
+                j->yerr = errno ? errno : EIO;
+        if (!j->derr && fstat(fd, &j->ds) == -1)
+                j->derr = errno;
+
+        if (close(fd) == -1 && !j->derr)
+                j->derr = errno;
+        if (sfd != -1)
+                close(sfd);
+}
+
+static void *p_clone_worker(void *arg)
+{
+        struct p_crun *r = arg;
+        size_t i = 0;
+        while ((i = atomic_fetch_add(&r->next, 1)) < r->n) {
+                p_clone_one(r, &r->j[i]);
+                if (!r->done)
+                        continue;
+                pthread_mutex_lock(&r->lock);
+                r->done(&r->j[i], r->arg);
+                pthread_mutex_unlock(&r->lock);
+        }
+        return NULL;
+}
+
+/* header functions */
+void p_clone_tree(struct p_cjob *j, size_t n, int dfd, int jobs,
+                const struct p_durable *dur, p_clone_fn done, void *arg)
+{
+        if (!j || !n)
+                return;
+
+        struct p_crun r;
+        r.j = j;
+        r.n = n;
+        r.dfd = dfd;
+        r.dur = dur;
+        r.done = done;
+        r.arg = arg;
+        atomic_init(&r.next, 0);
+        pthread_mutex_init(&r.lock, NULL);
+
+        size_t nt = jobs > 1 ? (size_t)jobs : 1;
+        if (nt > n)
+                nt = n;
+
+        /* the calling thread is one of the nt */
+        pthread_t *t = nt > 1 ? malloc((nt - 1) * sizeof(pthread_t)) : NULL;
+        size_t s = 0;
+        for (size_t i = 1; t && i < nt; i++)
+                if (pthread_create(&t[s], NULL, p_clone_worker, &r) == 0)
+                        s++;
+        p_clone_worker(&r);
+        for (size_t i = 0; i < s; i++)
+                pthread_join(t[i], NULL);
+        free(t);
+        pthread_mutex_destroy(&r.lock);
+}
@@ -0,0 +1,149 @@
+/*
+ * @file 	dirs.c
+ * @author 	sb
+ * @brief 	source file for dirs header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+#include "../inc/dirs.h"
+#include "../inc/hash.h"
+
+/* static utility functions */
+static struct p_dir_slot *p_dirs_slot(const struct p_dirs *d, uint64_t h,
+                const char *s, size_t l)
+{
+        /* the slot holding s, or the empty one where it belongs */
+        size_t m = d->cap - 1;
+        for (size_t i = h & m;; i = (i + 1) & m) {
+                struct p_dir_slot *e = &d->t[i];
+                if (!e->s || (e->h == h && e->l == l && !memcmp(e->s, s, l)))
+                        return e;
+        }
+}
+
+static int p_dirs_grow(struct p_dirs *d)
+{
+        size_t cap = d->cap ? d->cap * 2 : DIRS_CHUNK;
+        struct p_dir_slot *t = calloc(cap, sizeof(struct p_dir_slot));
+        if (!t)
+                return -1;
+
+        struct p_dirs g = { t, d->n, cap };
+        for (size_t i = 0; i < d->cap; i++)
+                if (d->t[i].s)
+                        *p_dirs_slot(&g, d->t[i].h, d->t[i].s,
+                                        d->t[i].l) = d->t[i];
+
+        free(d->t);
+        *d = g;
+        return 0;
+}
+
+static int p_dirs_add(struct p_dirs *d, uint64_t h, const char *s, size_t l)
+{
+        /* kept below three quarters full so that probes stay short */
+        if ((d->n + 1) * 4 > d->cap * 3 && p_dirs_grow(d))
+                return -1;
+
+        struct p_dir_slot *e = p_dirs_slot(d, h, s, l);
+        if (!(e->s = strndup(s, l)))
+                return -1;
+        e->h = h;
+        e->l = l;
+        d->n++;
+        return 0;
+}
+
+/* header functions */
+void p_dirs_init(struct p_dirs *d)
+{
+        d->t = NULL;
+        d->n = 0;
+        d->cap = 0;
+}
+
+int p_dirs_make(struct p_dirs *d, int dfd, const char *path)
+{
+        if (!d || !path) {
+                errno = EINVAL;
+                return -1;
+        }
+        if (!d->cap && p_dirs_grow(d))
+                return -1;
+
+        char buf[PATH_MAX];
+        size_t n = strlen(path);
+        while (n > 1 && path[n - 1] == '/')
+                n--;
+        if (n >= sizeof(buf)) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        memcpy(buf, path, n);
+        buf[n] = '\0';
+
+        /*
+         * the deepest known prefix is searched from the end, so a directory
+         * seen before costs one lookup and a new leaf only a few
+         */
+        size_t l = n;
+        for (;;) {
+                uint64_t h = p_hash_buf(buf, l);
+                if (p_dirs_slot(d, h, buf, l)->s)
+                        break;
+                while (l && buf[l - 1] != '/')
+                        l--;
+                while (l && buf[l - 1] == '/')
+                        l--;
+                if (!l)
+                        break;
+        }
+        if (l == n)
+                return 0;
+
+        /* everything below it is created or checked once, left to right */
+        while (l < n) {
+                while (l < n && buf[l] == '/')
+                        l++;
+                while (l < n && buf[l] != '/')
+                        l++;
+                buf[l] = '\0';
+
+                if (mkdirat(dfd, buf, DIRS_MODE) == -1) {
+                        struct stat s;
+                        if (errno != EEXIST || fstatat(dfd, buf, &s, 0) == -1)
+                                return -1;
+                        if (!S_ISDIR(s.st_mode)) {
+                                errno = ENOTDIR;
+                                return -1;
+                        }
+                }
+                if (p_dirs_add(d, p_hash_buf(buf, l), buf, l))
+                        return -1;
+
+                if (l < n)
+                        buf[l] = '/';
+        }
+
+        return 0;
+}
+
+void p_dirs_free(struct p_dirs *d)
+{
+        if (!d)
+                return;
+
+        for (size_t i = 0; i < d->cap; i++)
+                free(d->t[i].s);
+        free(d->t);
+        p_dirs_init(d);
+}
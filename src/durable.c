@@ -0,0 +1,178 @@
+/*
+ * @file 	durable.c
+ * @author 	sb
+ * @brief 	source file for durable header
+ */
+
+/* sync_file_range and syncfs are linux specific */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../inc/durable.h"
+
+/* static utility functions */
+static int p_durable_seen(const struct p_durable *d, const char *s, size_t l)
+{
+        /* most files land in the directory recorded last */
+        for (size_t i = d->n; i > 0; i--)
+                if (!strncmp(d->dirs[i - 1], s, l) && !d->dirs[i - 1][l])
+                        return 1;
+        return 0;
+}
+
+static int p_durable_add(struct p_durable *d, const char *s, size_t l)
+{
+        if (d->n == d->cap) {
+                size_t cap = d->cap ? d->cap * 2 : DURABLE_CHUNK;
+                char **g = realloc(d->dirs, cap * sizeof(char *));
+                if (!g)
+                        return 1;
+                d->dirs = g;
+                d->cap = cap;
+        }
+
+        if (!(d->dirs[d->n] = strndup(s, l)))
+                return 1;
+        d->n++;
+        return 0;
+}
+
+static int p_durable_dirs(struct p_durable *d, const char *path)
+{
+        /*
+         * a new entry is only durable once the directory holding it is
+         * synced, so every directory between path and the parent of the
+         * project directory is recorded, each one once
+         */
+        size_t rl = strlen(d->root);
+        size_t l = strlen(path);
+
+        while (l > rl) {
+                while (l > rl && path[l - 1] != '/')
+                        l--;
+                /* strip the separator, the root itself ends the walk */
+                size_t dl = l > rl ? l - 1 : rl;
+                if (p_durable_seen(d, path, dl))
+                        return 0;
+                if (p_durable_add(d, path, dl))
+                        return 1;
+                l = dl;
+        }
+
+        /* the entry of the project directory lives in its parent */
+        const char *sl = strrchr(d->root, '/');
+        const char *pd = sl ? (sl == d->root ? "/" : d->root) : ".";
+        size_t pl = sl ? (sl == d->root ? 1 : (size_t)(sl - d->root)) : 1;
+        if (p_durable_seen(d, pd, pl))
+                return 0;
+        return p_durable_add(d, pd, pl);
+}
+
+static int p_fsync_dir(int dfd, const char *path)
+{
+        int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+        if (fd == -1)
+                return 1;
+
+        int r = fsync(fd);
+        close(fd);
+        return r != 0;
+}
+
+/* header functions */
+int p_durable_parse(const char *s)
+{
+        if (!strcmp(s, "none"))
+                return DURABLE_NONE;
+        if (!strcmp(s, "batch"))
+                return DURABLE_BATCH;
+        if (!strcmp(s, "strict"))
+                return DURABLE_STRICT;
+        return -1;
+}
+
+void p_durable_init(struct p_durable *d, enum p_durability mode, int dfd,
+                const char *root)
+{
+        d->mode = mode;
+        d->dfd = dfd;
+        d->root = root;
+        d->dirs = NULL;
+        d->n = 0;
+        d->cap = 0;
+}
+
+int p_durable_sync(const struct p_durable *d, int fd)
+{
+        if (!d || d->mode == DURABLE_NONE)
+                return 0;
+
+        if (d->mode == DURABLE_STRICT)
+                return fsync(fd) != 0;
+
+        /* only start the writeback here - waiting for it is left to the
+         * single syncfs at the end */
+        (void)sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+        return 0;
+}
+
+int p_durable_path(struct p_durable *d, const char *path)
+{
+        if (!d || d->mode == DURABLE_NONE)
+                return 0;
+
+        return p_durable_dirs(d, path);
+}
+
+int p_durable_file(struct p_durable *d, int fd, const char *path)
+{
+        return p_durable_path(d, path) || p_durable_sync(d, fd);
+}
+
+int p_durable_finish(struct p_durable *d)
+{
+        if (!d || d->mode == DURABLE_NONE)
+                return 0;
+
+        int f = 0;
+        if (d->mode == DURABLE_BATCH) {
+                /* one flush of the filesystem covers every file, including
+                 * the ones written outside p_durable_file such as the
+                 * objects of a git repository */
+                int fd = openat(d->dfd, d->root, O_RDONLY | O_CLOEXEC |
+                                O_DIRECTORY);
+                if (fd == -1 || syncfs(fd))
+                        f++;
+                if (fd != -1)
+                        close(fd);
+        }
+
+        /* the project directory is synced even when it got no files */
+        if (!d->n && p_durable_dirs(d, d->root))
+                f++;
+        if (!p_durable_seen(d, d->root, strlen(d->root)))
+                f += p_fsync_dir(d->dfd, d->root);
+
+        for (size_t i = 0; i < d->n; i++)
+                f += p_fsync_dir(d->dfd, d->dirs[i]);
+
+        return f;
+}
+
+void p_durable_free(struct p_durable *d)
+{
+        if (!d)
+                return;
+
+        for (size_t i = 0; i < d->n; i++)
+                free(d->dirs[i]);
+        free(d->dirs);
+        d->dirs = NULL;
+        d->n = 0;
+        d->cap = 0;
+}
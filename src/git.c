@@ -0,0 +1,631 @@
+/*
+ * @file 	git.c
+ * @author 	sb
+ * @brief 	source file for git header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <linux/limits.h>
+#include "../inc/git.h"
+
+/* growable byte buffer for trees and the index */
+struct p_buf {
+        unsigned char *d;
+        size_t n;
+        size_t cap;
+};
+
+/* a zlib stream of stored blocks being written, filled in place */
+struct p_git_obj {
+        struct p_sha1 s;        /* name of the object, when hashed here */
+        int hash;
+        int fd;
+        uint32_t a;             /* adler32 of the stored bytes */
+        uint32_t b;
+        size_t left;            /* bytes not placed in a block yet */
+        size_t bn;              /* length of the current block */
+        size_t bl;              /* bytes in the current block */
+        size_t off;             /* 2 while the zlib header leads the block */
+        unsigned char blk[2 + 5 + GIT_BLOCK + 4];
+};
+
+/* static utility functions */
+static int p_buf_put(struct p_buf *b, const void *d, size_t n)
+{
+        if (b->n + n > b->cap) {
+                size_t cap = b->cap ? b->cap : 256;
+                while (cap < b->n + n)
+                        cap *= 2;
+                unsigned char *g = realloc(b->d, cap);
+                if (!g)
+                        return 1;
+                b->d = g;
+                b->cap = cap;
+        }
+
+        memcpy(b->d + b->n, d, n);
+        b->n += n;
+        return 0;
+}
+
+static int p_buf_be32(struct p_buf *b, uint32_t v)
+{
+        unsigned char c[4] = { v >> 24, v >> 16, v >> 8, v };
+        return p_buf_put(b, c, 4);
+}
+
+static int p_write_all(int fd, const void *d, size_t n)
+{
+        const char *p = d;
+
+        while (n) {
+                ssize_t r = write(fd, p, n);
+                if (r == -1 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return 1;
+                p += r;
+                n -= r;
+        }
+
+        return 0;
+}
+
+static int p_git_path(const struct p_git *g, char *buf, const char *rel)
+{
+        int r = snprintf(buf, PATH_MAX, "%s/%s/%s", g->wt, GIT_DIR, rel);
+        return r < 0 || r >= PATH_MAX;
+}
+
+static int p_git_file(const struct p_git *g, const char *rel, const void *d,
+                size_t n)
+{
+        char fp[PATH_MAX];
+        if (p_git_path(g, fp, rel))
+                return 1;
+
+        int fd = openat(g->dfd, fp, O_WRONLY | O_CLOEXEC | O_CREAT | O_TRUNC,
+                        0644);
+        if (fd == -1)
+                return 1;
+        int r = p_write_all(fd, d, n);
+        return close(fd) || r;
+}
+
+static void p_adler(uint32_t *a, uint32_t *b, const unsigned char *d,
+                size_t n)
+{
+        /* 5552 bytes is the most the sums take before they can overflow */
+        while (n) {
+                size_t k = n < 5552 ? n : 5552;
+                n -= k;
+                while (k--) {
+                        *a += *d++;
+                        *b += *a;
+                }
+                *a %= 65521;
+                *b %= 65521;
+        }
+}
+
+static void p_obj_block(struct p_git_obj *o)
+{
+        /* the length of every block is known up front from the size, so
+         * the last one is marked final before its bytes arrive */
+        unsigned char *h = o->blk + o->off;
+        o->bn = o->left < GIT_BLOCK ? o->left : GIT_BLOCK;
+        o->bl = 0;
+        h[0] = o->bn == o->left;
+        h[1] = o->bn & 0xff;
+        h[2] = o->bn >> 8;
+        h[3] = ~o->bn & 0xff;
+        h[4] = (~o->bn >> 8) & 0xff;
+}
+
+static unsigned char *p_obj_room(struct p_git_obj *o, size_t *k)
+{
+        *k = o->bn - o->bl;
+        return o->blk + o->off + 5 + o->bl;
+}
+
+static int p_obj_fill(struct p_git_obj *o, size_t k)
+{
+        /* k bytes were placed at p_obj_room, a full block is written */
+        unsigned char *d = o->blk + o->off + 5 + o->bl;
+        if (o->hash)
+                p_sha1_update(&o->s, d, k);
+        p_adler(&o->a, &o->b, d, k);
+        o->bl += k;
+        o->left -= k;
+        if (o->bl < o->bn)
+                return 0;
+
+        size_t n = o->off + 5 + o->bn;
+        if (!o->left) {
+                uint32_t ad = o->b << 16 | o->a;
+                unsigned char *t = o->blk + n;
+                t[0] = ad >> 24;
+                t[1] = ad >> 16;
+                t[2] = ad >> 8;
+                t[3] = ad;
+                n += 4;
+        }
+
+        if (p_write_all(o->fd, o->blk, n))
+                return 1;
+        o->off = 0;
+        if (o->left)
+                p_obj_block(o);
+        return 0;
+}
+
+static int p_obj_put(struct p_git_obj *o, const void *d, size_t n)
+{
+        const unsigned char *c = d;
+
+        while (n) {
+                size_t k;
+                unsigned char *r = p_obj_room(o, &k);
+                if (!k)
+                        return 1;
+                if (k > n)
+                        k = n;
+                memcpy(r, c, k);
+                if (p_obj_fill(o, k))
+                        return 1;
+                c += k;
+                n -= k;
+        }
+
+        return 0;
+}
+
+static int p_obj_start(struct p_git_obj *o, int fd, int hash,
+                const char *type, size_t n)
+{
+        /*
+         * zlib stream made of stored deflate blocks - valid for every
+         * reader and free of a compression library, objects are only
+         * written once here and packed by git later on
+         */
+        char hdr[64];
+        size_t hl = snprintf(hdr, sizeof(hdr), "%s %zu", type, n) + 1;
+
+        o->fd = fd;
+        o->hash = hash;
+        if (hash)
+                p_sha1_init(&o->s);
+        o->a = 1;
+        o->b = 0;
+        o->left = hl + n;
+        o->blk[0] = 0x78;
+        o->blk[1] = 0x01;
+        o->off = 2;
+        p_obj_block(o);
+        return p_obj_put(o, hdr, hl);
+}
+
+static int p_git_fan(struct p_git *g, const char *hex, const unsigned char *sha,
+                char *fp)
+{
+        /* fp is set to the path of the object */
+        char rel[SHA1_HEX_LEN + 16];
+
+        if (!(g->fan[sha[0] / 8] & (1 << (sha[0] % 8)))) {
+                snprintf(rel, sizeof(rel), "objects/%.2s", hex);
+                if (p_git_path(g, fp, rel) ||
+                                (mkdirat(g->dfd, fp, 0755) && errno != EEXIST))
+                        return 1;
+                g->fan[sha[0] / 8] |= 1 << (sha[0] % 8);
+        }
+
+        snprintf(rel, sizeof(rel), "objects/%.2s/%s", hex, hex + 2);
+        return p_git_path(g, fp, rel);
+}
+
+static int p_git_object(struct p_git *g, const char *type, const void *d,
+                size_t n, unsigned char *sha)
+{
+        /* the header is part of both the name and the stored bytes */
+        char hdr[64];
+        size_t hl = snprintf(hdr, sizeof(hdr), "%s %zu", type, n) + 1;
+
+        struct p_sha1 s;
+        p_sha1_init(&s);
+        p_sha1_update(&s, hdr, hl);
+        p_sha1_update(&s, d, n);
+        p_sha1_final(&s, sha);
+
+        char hex[SHA1_HEX_LEN + 1];
+        char fp[PATH_MAX];
+        p_sha1_hex(sha, hex);
+        if (p_git_fan(g, hex, sha, fp))
+                return 1;
+
+        /* named before it is written, so a stored object is left alone */
+        int fd = openat(g->dfd, fp, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL,
+                        0444);
+        if (fd == -1)
+                return errno == EEXIST ? 0 : 1;
+
+        struct p_git_obj o;
+        int r = p_obj_start(&o, fd, 0, type, n) || p_obj_put(&o, d, n);
+        if (close(fd) || r) {
+                unlinkat(g->dfd, fp, 0);
+                return 1;
+        }
+
+        return 0;
+}
+
+static int p_git_tmp(struct p_git *g, char *tp)
+{
+        /* an object read from a file is named once it is written */
+        for (int i = 0; i < GIT_TMP_TRIES; i++) {
+                char rel[64];
+                snprintf(rel, sizeof(rel), "objects/tmp_obj_%ld_%u",
+                                (long)getpid(), g->tmp++);
+                if (p_git_path(g, tp, rel))
+                        return -1;
+                int fd = openat(g->dfd, tp, O_WRONLY | O_CLOEXEC | O_CREAT |
+                                O_EXCL, 0444);
+                if (fd != -1 || errno != EEXIST)
+                        return fd;
+        }
+
+        return -1;
+}
+
+static void p_git_sweep(struct p_git *g)
+{
+        /* objects an interrupted run was still writing under a temporary
+         * name are of no use to anyone */
+        char fp[PATH_MAX];
+        if (p_git_path(g, fp, "objects"))
+                return;
+        int fd = openat(g->dfd, fp, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+        DIR *d = fd == -1 ? NULL : fdopendir(fd);
+        if (!d) {
+                if (fd != -1)
+                        close(fd);
+                return;
+        }
+
+        struct dirent *e;
+        while ((e = readdir(d)))
+                if (!strncmp(e->d_name, "tmp_obj_", 8))
+                        unlinkat(fd, e->d_name, 0);
+        closedir(d);
+}
+
+static int p_git_stage(struct p_git *g, const char *path,
+                const unsigned char *sha, const struct stat *st)
+{
+        if (g->n == g->cap) {
+                size_t cap = g->cap ? g->cap * 2 : GIT_CHUNK;
+                struct p_git_entry *e = realloc(g->e, cap * sizeof(*e));
+                if (!e)
+                        return 1;
+                g->e = e;
+                g->cap = cap;
+        }
+
+        struct p_git_entry *e = &g->e[g->n];
+        if (!(e->path = strdup(path)))
+                return 1;
+        memcpy(e->sha, sha, SHA1_LEN);
+        e->st = *st;
+        e->seq = g->n++;
+        return 0;
+}
+
+static int p_git_cmp(const void *a, const void *b)
+{
+        const struct p_git_entry *x = a;
+        const struct p_git_entry *y = b;
+        int r = strcmp(x->path, y->path);
+
+        /* the later addition of a path wins, it sorts first */
+        if (!r)
+                r = x->seq < y->seq ? 1 : -1;
+        return r;
+}
+
+static uint32_t p_git_mode(const struct stat *st)
+{
+        return st->st_mode & S_IXUSR ? 0100755 : 0100644;
+}
+
+static int p_git_tree(struct p_git *g, size_t lo, size_t hi, size_t pl,
+                unsigned char *sha)
+{
+        /*
+         * entries [lo, hi) share the first pl bytes of their paths; sorting
+         * by the full path already gives the order git wants in a tree,
+         * where a directory sorts as its name followed by '/'
+         */
+        struct p_buf t = { NULL, 0, 0 };
+        int r = 0;
+
+        for (size_t i = lo; !r && i < hi; ) {
+                const char *name = g->e[i].path + pl;
+                const char *sl = strchr(name, '/');
+                char m[16];
+
+                if (!sl) {
+                        snprintf(m, sizeof(m), "%o ", p_git_mode(&g->e[i].st));
+                        r = p_buf_put(&t, m, strlen(m)) ||
+                                p_buf_put(&t, name, strlen(name) + 1) ||
+                                p_buf_put(&t, g->e[i].sha, SHA1_LEN);
+                        i++;
+                        continue;
+                }
+
+                size_t nl = sl - name;
+                size_t j = i + 1;
+                while (j < hi && !strncmp(g->e[j].path + pl, name, nl + 1))
+                        j++;
+
+                unsigned char sub[SHA1_LEN];
+                r = p_git_tree(g, i, j, pl + nl + 1, sub) ||
+                        p_buf_put(&t, "40000 ", 6) ||
+                        p_buf_put(&t, name, nl) ||
+                        p_buf_put(&t, "", 1) ||
+                        p_buf_put(&t, sub, SHA1_LEN);
+                i = j;
+        }
+
+        if (!r)
+                r = p_git_object(g, "tree", t.d ? (void *)t.d : "", t.n, sha);
+        free(t.d);
+        return r;
+}
+
+static int p_git_index(struct p_git *g)
+{
+        struct p_buf x = { NULL, 0, 0 };
+        int r = p_buf_put(&x, "DIRC", 4) || p_buf_be32(&x, 2) ||
+                p_buf_be32(&x, g->n);
+
+        for (size_t i = 0; !r && i < g->n; i++) {
+                const struct p_git_entry *e = &g->e[i];
+                size_t nl = strlen(e->path);
+                unsigned char fl[2] = { (nl < 0xfff ? nl : 0xfff) >> 8,
+                        (nl < 0xfff ? nl : 0xfff) & 0xff };
+                unsigned char pad[8] = { 0 };
+
+                r = p_buf_be32(&x, e->st.st_ctim.tv_sec) ||
+                        p_buf_be32(&x, e->st.st_ctim.tv_nsec) ||
+                        p_buf_be32(&x, e->st.st_mtim.tv_sec) ||
+                        p_buf_be32(&x, e->st.st_mtim.tv_nsec) ||
+                        p_buf_be32(&x, e->st.st_dev) ||
+                        p_buf_be32(&x, e->st.st_ino) ||
+                        p_buf_be32(&x, p_git_mode(&e->st)) ||
+                        p_buf_be32(&x, e->st.st_uid) ||
+                        p_buf_be32(&x, e->st.st_gid) ||
+                        p_buf_be32(&x, e->st.st_size) ||
+                        p_buf_put(&x, e->sha, SHA1_LEN) ||
+                        p_buf_put(&x, fl, 2) ||
+                        p_buf_put(&x, e->path, nl) ||
+                        /* NUL padded to a multiple of 8, at least one */
+                        p_buf_put(&x, pad, 8 - (62 + nl) % 8);
+        }
+
+        unsigned char sum[SHA1_LEN];
+        if (!r) {
+                struct p_sha1 s;
+                p_sha1_init(&s);
+                p_sha1_update(&s, x.d, x.n);
+                p_sha1_final(&s, sum);
+                r = p_buf_put(&x, sum, SHA1_LEN) ||
+                        p_git_file(g, "index", x.d, x.n);
+        }
+
+        free(x.d);
+        return r;
+}
+
+static void p_git_ident(char *buf, size_t n, const char *who, time_t ts)
+{
+        char nv[32];
+        char ev[32];
+        snprintf(nv, sizeof(nv), "GIT_%s_NAME", who);
+        snprintf(ev, sizeof(ev), "GIT_%s_EMAIL", who);
+
+        const char *user = getenv("USER");
+        const char *name = getenv(nv);
+        const char *mail = getenv(ev);
+        if (!user || !*user)
+                user = "mkproject";
+
+        if (mail && *mail)
+                snprintf(buf, n, "%s <%s> %lld +0000", name && *name ?
+                                name : user, mail, (long long)ts);
+        else
+                snprintf(buf, n, "%s <%s@localhost> %lld +0000", name &&
+                                *name ? name : user, user, (long long)ts);
+}
+
+/* header functions */
+int p_git_init(struct p_git *g, int dfd, const char *wt, int reuse)
+{
+        if (!g || !wt)
+                return 1;
+
+        memset(g, 0, sizeof(*g));
+        g->dfd = dfd;
+        if (!(g->wt = strdup(wt)))
+                return 1;
+
+        char fp[PATH_MAX];
+        snprintf(fp, PATH_MAX, "%s/%s", wt, GIT_DIR);
+        if (mkdirat(dfd, fp, 0755) && (errno != EEXIST || !reuse))
+                return errno == EEXIST ? 2 : 1;
+
+        /* objects are named by their content, so whatever an interrupted
+         * run stored already is simply found again */
+        const char *dirs[] = { "objects", "refs", "refs/heads", "refs/tags" };
+        for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+                if (p_git_path(g, fp, dirs[i]) || (mkdirat(dfd, fp, 0755) &&
+                                        (errno != EEXIST || !reuse)))
+                        return 1;
+        if (reuse)
+                p_git_sweep(g);
+
+        const char head[] = "ref: refs/heads/" GIT_BRANCH "\n";
+        const char conf[] = "[core]\n"
+                "\trepositoryformatversion = 0\n"
+                "\tfilemode = true\n"
+                "\tbare = false\n"
+                "\tlogallrefupdates = true\n";
+        return p_git_file(g, "HEAD", head, strlen(head)) ||
+                p_git_file(g, "config", conf, strlen(conf));
+}
+
+int p_git_add(struct p_git *g, const char *path, const void *d, size_t n,
+                const struct stat *st)
+{
+        if (!g || !path || !st)
+                return 1;
+
+        unsigned char sha[SHA1_LEN];
+        return p_git_object(g, "blob", n ? d : "", n, sha) ||
+                p_git_stage(g, path, sha, st);
+}
+
+int p_git_copy(struct p_git *g, const char *path, int sfd, int dfd, size_t n)
+{
+        if (!g || !path)
+                return 1;
+
+        char tp[PATH_MAX];
+        int fd = p_git_tmp(g, tp);
+        if (fd == -1)
+                return 1;
+
+        /* every chunk is read straight into the block it is stored in,
+         * then copied out of it to the work tree */
+        struct p_git_obj o;
+        int r = p_obj_start(&o, fd, 1, "blob", n);
+        while (!r && o.left) {
+                size_t k;
+                unsigned char *c = p_obj_room(&o, &k);
+                ssize_t got = read(sfd, c, k);
+                if (got == -1 && errno == EINTR)
+                        continue;
+                if (got <= 0 || (dfd != -1 && p_write_all(dfd, c, got)))
+                        r = -1;
+                else
+                        r = p_obj_fill(&o, got);
+        }
+
+        struct stat st;
+        unsigned char sha[SHA1_LEN];
+        char hex[SHA1_HEX_LEN + 1];
+        char fp[PATH_MAX];
+        if (close(fd) && !r)
+                r = 1;
+        if (!r && fstat(dfd != -1 ? dfd : sfd, &st))
+                r = -1;
+        if (!r) {
+                p_sha1_final(&o.s, sha);
+                p_sha1_hex(sha, hex);
+                r = p_git_fan(g, hex, sha, fp);
+        }
+
+        /* a stored object has the same bytes, the copy is dropped */
+        struct stat os;
+        if (r || fstatat(g->dfd, fp, &os, 0) == 0) {
+                unlinkat(g->dfd, tp, 0);
+        } else if (renameat(g->dfd, tp, g->dfd, fp)) {
+                unlinkat(g->dfd, tp, 0);
+                r = 1;
+        }
+
+        return r ? r : p_git_stage(g, path, sha, &st);
+}
+
+int p_git_add_file(struct p_git *g, const char *path)
+{
+        char fp[PATH_MAX];
+        snprintf(fp, PATH_MAX, "%s/%s", g->wt, path);
+
+        int fd = openat(g->dfd, fp, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+                return 1;
+
+        struct stat st;
+        int r = fstat(fd, &st) || p_git_copy(g, path, fd, -1, st.st_size);
+        close(fd);
+        return r;
+}
+
+int p_git_commit(struct p_git *g)
+{
+        if (!g || !g->wt)
+                return 1;
+
+        /* sort and drop the older entries of paths added twice */
+        qsort(g->e, g->n, sizeof(struct p_git_entry), p_git_cmp);
+        size_t k = 0;
+        for (size_t i = 0; i < g->n; i++) {
+                if (k && !strcmp(g->e[k - 1].path, g->e[i].path)) {
+                        free(g->e[i].path);
+                        continue;
+                }
+                g->e[k++] = g->e[i];
+        }
+        g->n = k;
+
+        unsigned char tree[SHA1_LEN];
+        unsigned char commit[SHA1_LEN];
+        char th[SHA1_HEX_LEN + 1];
+        char ch[SHA1_HEX_LEN + 2];
+        char au[512];
+        char co[512];
+        char msg[1200 + SHA1_HEX_LEN];
+
+        if (p_git_tree(g, 0, g->n, 0, tree))
+                return 1;
+        p_sha1_hex(tree, th);
+
+        time_t ts = time(NULL);
+        p_git_ident(au, sizeof(au), "AUTHOR", ts);
+        p_git_ident(co, sizeof(co), "COMMITTER", ts);
+        int ml = snprintf(msg, sizeof(msg), "tree %s\nauthor %s\n"
+                        "committer %s\n\n%s\n", th, au, co, GIT_MESSAGE);
+        if (ml < 0 || ml >= (int)sizeof(msg) ||
+                        p_git_object(g, "commit", msg, ml, commit))
+                return 1;
+
+        p_sha1_hex(commit, ch);
+        strcat(ch, "\n");
+        return p_git_file(g, "refs/heads/" GIT_BRANCH, ch, strlen(ch)) ||
+                p_git_index(g);
+}
+
+void p_git_free(struct p_git *g)
+{
+        if (!g)
+                return;
+
+        for (size_t i = 0; i < g->n; i++)
+                free(g->e[i].path);
+        free(g->e);
+        free(g->wt);
+        g->e = NULL;
+        g->wt = NULL;
+        g->n = 0;
+        g->cap = 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * @file 	hash.c
+ * @author 	sb
+ * @brief 	source file for hash header - XXH64 compatible content hash
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "../inc/hash.h"
+
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+/* static utility functions */
+static inline uint64_t p_rotl(uint64_t x, int r)
+{
+        return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t p_read64(const unsigned char *p)
+{
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+static inline uint32_t p_read32(const unsigned char *p)
+{
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+static inline uint64_t p_round(uint64_t acc, uint64_t in)
+{
+        acc += in * P2;
+        acc = p_rotl(acc, 31);
+        return acc * P1;
+}
+
+static inline uint64_t p_merge(uint64_t acc, uint64_t v)
+{
+        acc ^= p_round(0, v);
+        return acc * P1 + P4;
+}
+
+/* header functions */
+void p_hash_init(struct p_hash *h, uint64_t seed)
+{
+        memset(h, 0, sizeof(*h));
+        h->v[0] = seed + P1 + P2;
+        h->v[1] = seed + P2;
+        h->v[2] = seed;
+        h->v[3] = seed - P1;
+}
+
+void p_hash_update(struct p_hash *h, const void *d, size_t n)
+{
+        const unsigned char *p = d;
+        const unsigned char *e = p + n;
+
+        h->total += n;
+
+        if (h->memsz + n < 32) {
+                memcpy(h->mem + h->memsz, p, n);
+                h->memsz += n;
+                return;
+        }
+
+        if (h->memsz) {
+                /* complete the pending stripe first */
+                size_t f = 32 - h->memsz;
+                memcpy(h->mem + h->memsz, p, f);
+                for (int i = 0; i < 4; i++)
+                        h->v[i] = p_round(h->v[i], p_read64(h->mem + i * 8));
+                p += f;
+                h->memsz = 0;
+        }
+
+        for (; p + 32 <= e; p += 32)
+                for (int i = 0; i < 4; i++)
+                        h->v[i] = p_round(h->v[i], p_read64(p + i * 8));
+
+        if (p < e) {
+                memcpy(h->mem, p, e - p);
+                h->memsz = e - p;
+        }
+}
+
+uint64_t p_hash_digest(const struct p_hash *h)
+{
+        uint64_t r;
+
+        if (h->total >= 32) {
+                r = p_rotl(h->v[0], 1) + p_rotl(h->v[1], 7)
+                        + p_rotl(h->v[2], 12) + p_rotl(h->v[3], 18);
+                for (int i = 0; i < 4; i++)
+                        r = p_merge(r, h->v[i]);
+        } else {
+                /* v[2] still holds the seed untouched */
+                r = h->v[2] + P5;
+        }
+
+        r += h->total;
+
+        const unsigned char *p = h->mem;
+        const unsigned char *e = p + h->memsz;
+        for (; p + 8 <= e; p += 8) {
+                r ^= p_round(0, p_read64(p));
+                r = p_rotl(r, 27) * P1 + P4;
+        }
+        if (p + 4 <= e) {
+                r ^= (uint64_t)p_read32(p) * P1;
+                r = p_rotl(r, 23) * P2 + P3;
+                p += 4;
+        }
+        for (; p < e; p++) {
+                r ^= *p * P5;
+                r = p_rotl(r, 11) * P1;
+        }
+
+        r ^= r >> 33;
+        r *= P2;
+        r ^= r >> 29;
+        r *= P3;
+        r ^= r >> 32;
+
+        return r;
+}
+
+uint64_t p_hash_buf(const void *d, size_t n)
+{
+        struct p_hash h;
+        p_hash_init(&h, HASH_SEED);
+        p_hash_update(&h, d, n);
+        return p_hash_digest(&h);
+}
+
+int p_hash_fd(int fd, uint64_t *r)
+{
+        struct p_hash h;
+        char buf[65536];
+        ssize_t n = 0;
+
+        p_hash_init(&h, HASH_SEED);
+        while ((n = read(fd, buf, sizeof(buf))) != 0) {
+                if (n == -1) {
+                        if (errno == EINTR)
+                                continue;
+                        return -1;
+                }
+                p_hash_update(&h, buf, n);
+        }
+
+        *r = p_hash_digest(&h);
+        return 0;
+}
+
+void p_hash_hex(uint64_t h, char *s)
+{
+        snprintf(s, HASH_HEX_LEN + 1, "%016llx", (unsigned long long)h);
+}
@@ -0,0 +1,434 @@
+/*
+ * @file 	hooks.c
+ * @author 	sb
+ * @brief 	source file for hooks header
+ */
+
+/* pidfd_open is linux specific */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "../inc/hooks.h"
+#include "../inc/project.h"
+
+extern char **environ;
+
+/* static utility functions */
+static void p_hooks_msg(const struct p_hooks *hs, const char *fmt, ...)
+{
+        if (!hs->out)
+                return;
+
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(hs->out, fmt, ap);
+        va_end(ap);
+}
+
+static char *p_hook_str(const char *js, const jsmntok_t *t)
+{
+        return strndup(js + t->start, t->end - t->start);
+}
+
+static size_t p_hook_find(const struct p_hooks *hs, const char *js,
+                const jsmntok_t *t)
+{
+        for (size_t i = 0; i < hs->n; i++)
+                if (p_jsoneq(js, (jsmntok_t *)t, hs->h[i].name) == 0)
+                        return i;
+        return hs->n;
+}
+
+static int p_hook_body(struct p_hooks *hs, struct p_hook *h, const char *js,
+                const jsmntok_t *t, int nt, int i)
+{
+        /*
+         * 0 -> success
+         * 1 -> failure
+         */
+        if (i >= nt || t[i].type != JSMN_OBJECT) {
+                p_hooks_msg(hs, "%s : hook has to be an object\n", h->name);
+                return 1;
+        }
+
+        int j = i + 1;
+        for (int k = 0; k < t[i].size && j + 1 < nt; k++) {
+                const jsmntok_t *v = &t[j + 1];
+
+                if (p_jsoneq(js, (jsmntok_t *)&t[j], HOOK_CMD) == 0 &&
+                                v->type == JSMN_STRING) {
+                        free(h->cmd);
+                        h->cmd = p_hook_str(js, v);
+                } else if (p_jsoneq(js, (jsmntok_t *)&t[j], HOOK_AFTER) == 0
+                                && v->type == JSMN_ARRAY) {
+                        h->after = calloc(v->size ? v->size : 1,
+                                        sizeof(size_t));
+                        for (int e = 0; h->after && e < v->size; e++) {
+                                size_t d = p_hook_find(hs, js, v + 1 + e);
+                                if (d == hs->n) {
+                                        p_hooks_msg(hs, "%s : unknown hook "
+                                                        "in %s\n", h->name,
+                                                        HOOK_AFTER);
+                                        return 1;
+                                }
+                                h->after[h->nafter++] = d;
+                        }
+                } else if (p_jsoneq(js, (jsmntok_t *)&t[j], HOOK_NEEDS) == 0
+                                && v->type == JSMN_ARRAY) {
+                        h->needs = calloc(v->size ? v->size : 1,
+                                        sizeof(char *));
+                        for (int e = 0; h->needs && e < v->size; e++)
+                                h->needs[h->nneeds++] =
+                                        p_hook_str(js, v + 1 + e);
+                        h->pending = h->nneeds;
+                }
+
+                j = p_skip_token(t, j + 1);
+        }
+
+        if (!h->cmd) {
+                p_hooks_msg(hs, "%s : hook has no %s\n", h->name, HOOK_CMD);
+                return 1;
+        }
+
+        return 0;
+}
+
+static void p_hook_report(const struct p_hooks *hs, struct p_hook *h)
+{
+        p_hooks_msg(hs, "Hook %s : %s", h->name,
+                        h->state == HOOK_DONE ? "done" : "failed");
+        if (h->state == HOOK_FAILED)
+                p_hooks_msg(hs, " (exit status %d)", h->status);
+        p_hooks_msg(hs, "\n");
+
+        /* replay the collected output in one piece */
+        char buf[4096];
+        ssize_t r = 0;
+        if (hs->out && h->out != -1 && lseek(h->out, 0, SEEK_SET) == 0)
+                while ((r = read(h->out, buf, sizeof(buf))) > 0)
+                        if (fwrite(buf, 1, r, hs->out) != (size_t)r)
+                                break;
+        if (hs->out)
+                fflush(hs->out);
+
+        if (h->out != -1)
+                close(h->out);
+        h->out = -1;
+}
+
+static int p_hook_pidfd(pid_t pid)
+{
+        /* a descriptor which becomes readable once the process exits,
+         * always close-on-exec */
+#ifdef SYS_pidfd_open
+        return syscall(SYS_pidfd_open, pid, 0);
+#else
+        (void)pid;
+        return -1;
+#endif
+}
+
+static int p_hook_start(struct p_hooks *hs, struct p_hook *h)
+{
+        const char *tmp = getenv("TMPDIR");
+        char tp[256];
+        snprintf(tp, sizeof(tp), "%s/mkp-hook-XXXXXX", tmp ? tmp : "/tmp");
+
+        h->out = mkostemp(tp, O_CLOEXEC);
+        if (h->out == -1) {
+                p_hooks_msg(hs, "Hook %s : unable to create output file - "
+                                "%s\n", h->name, strerror(errno));
+                return 1;
+        }
+        unlink(tp);
+
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null",
+                        O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&fa, h->out, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&fa, h->out, STDERR_FILENO);
+
+        /* the shell changes into the project directory itself, so the
+         * spawn needs no chdir in the parent */
+        char *argv[] = {
+                HOOK_SHELL, "-c", "cd -- \"$0\" || exit 127; eval \"$1\"",
+                (char *)hs->dir, h->cmd, NULL
+        };
+
+        int r = posix_spawn(&h->pid, HOOK_SHELL, &fa, NULL, argv, environ);
+        posix_spawn_file_actions_destroy(&fa);
+        if (r) {
+                p_hooks_msg(hs, "Hook %s : unable to spawn - %s\n", h->name,
+                                strerror(r));
+                return 1;
+        }
+
+        h->pfd = p_hook_pidfd(h->pid);
+        h->state = HOOK_RUNNING;
+        hs->running++;
+        return 0;
+}
+
+static size_t p_hooks_reap(struct p_hooks *hs)
+{
+        /* only the children started here are waited for */
+        size_t c = 0;
+
+        for (size_t i = 0; i < hs->n; i++) {
+                struct p_hook *h = &hs->h[i];
+                int st = 0;
+                if (h->state != HOOK_RUNNING ||
+                                waitpid(h->pid, &st, WNOHANG) != h->pid)
+                        continue;
+
+                h->status = WIFEXITED(st) ? WEXITSTATUS(st) : 128;
+                h->state = h->status ? HOOK_FAILED : HOOK_DONE;
+                if (h->pfd != -1)
+                        close(h->pfd);
+                h->pfd = -1;
+                hs->running--;
+                c++;
+                p_hook_report(hs, h);
+        }
+
+        return c;
+}
+
+static void p_hooks_wait(struct p_hooks *hs)
+{
+        /*
+         * sleeps until one of the running hooks exits - their pidfds are
+         * polled together, a hook without one is waited for on its own.
+         * Nothing is reaped here, that is left to p_hooks_reap
+         */
+        struct pollfd *pf = malloc(hs->n * sizeof(struct pollfd));
+        const struct p_hook *b = NULL;
+        nfds_t n = 0;
+
+        for (size_t i = 0; i < hs->n; i++) {
+                const struct p_hook *h = &hs->h[i];
+                if (h->state != HOOK_RUNNING)
+                        continue;
+                if (h->pfd == -1 || !pf) {
+                        b = h;
+                        break;
+                }
+                pf[n].fd = h->pfd;
+                pf[n].events = POLLIN;
+                n++;
+        }
+
+        siginfo_t si;
+        if (b)
+                (void)waitid(P_PID, b->pid, &si, WEXITED | WNOWAIT);
+        else if (n)
+                (void)poll(pf, n, -1);
+        free(pf);
+}
+
+static size_t p_hooks_schedule(struct p_hooks *hs)
+{
+        /* returns the number of hooks started or skipped */
+        size_t c = 0;
+
+        p_hooks_reap(hs);
+        for (size_t i = 0; i < hs->n; i++) {
+                struct p_hook *h = &hs->h[i];
+                if (h->state != HOOK_WAITING)
+                        continue;
+
+                int ready = !h->pending && (h->nneeds || hs->scaffolded);
+                for (size_t d = 0; d < h->nafter; d++) {
+                        enum p_hook_state s = hs->h[h->after[d]].state;
+                        if (s == HOOK_FAILED || s == HOOK_SKIPPED) {
+                                p_hooks_msg(hs, "Hook %s : skipped, %s did "
+                                                "not succeed\n", h->name,
+                                                hs->h[h->after[d]].name);
+                                h->state = HOOK_SKIPPED;
+                                ready = 0;
+                                c++;
+                                /* later hooks may depend on this one */
+                                i = (size_t)-1;
+                                break;
+                        }
+                        if (s != HOOK_DONE)
+                                ready = 0;
+                }
+
+                if (ready && hs->running < hs->jobs) {
+                        if (p_hook_start(hs, h))
+                                h->state = HOOK_FAILED;
+                        c++;
+                }
+        }
+
+        return c;
+}
+
+/* header functions */
+int p_hooks_load(struct p_hooks *hs, const char *js, const jsmntok_t *t,
+                int nt, int i)
+{
+        if (!hs || !js || !t || i >= nt || t[i].type != JSMN_OBJECT) {
+                if (hs)
+                        p_hooks_msg(hs, "Structure of the %s object is not "
+                                        "proper\n", TEMPL_HOOK_ID);
+                return 1;
+        }
+
+        hs->h = calloc(t[i].size ? t[i].size : 1, sizeof(struct p_hook));
+        hs->n = 0;
+        hs->running = 0;
+        hs->scaffolded = 0;
+        if (!hs->h)
+                return 1;
+
+        /* names first, so that after can refer to any hook */
+        int j = i + 1;
+        for (int k = 0; k < t[i].size && j + 1 < nt; k++) {
+                struct p_hook *h = &hs->h[hs->n++];
+                h->name = p_hook_str(js, &t[j]);
+                h->out = -1;
+                h->pfd = -1;
+                h->state = HOOK_WAITING;
+                j = p_skip_token(t, j + 1);
+        }
+
+        j = i + 1;
+        for (size_t k = 0; k < hs->n; k++) {
+                if (p_hook_body(hs, &hs->h[k], js, t, nt, j + 1))
+                        return 1;
+                j = p_skip_token(t, j + 1);
+        }
+
+        return 0;
+}
+
+int p_hooks_copy(struct p_hooks *d, const struct p_hooks *s)
+{
+        if (!d || !s)
+                return 1;
+
+        memset(d, 0, sizeof(*d));
+        d->jobs = s->jobs;
+        d->out = s->out;
+        if (!(d->h = calloc(s->n ? s->n : 1, sizeof(struct p_hook))))
+                return 1;
+
+        for (size_t i = 0; i < s->n; i++) {
+                const struct p_hook *o = &s->h[i];
+                struct p_hook *h = &d->h[d->n++];
+                h->out = -1;
+                h->pfd = -1;
+                h->state = HOOK_WAITING;
+                if (!(h->name = strdup(o->name)) ||
+                                !(h->cmd = strdup(o->cmd)) ||
+                                !(h->after = calloc(o->nafter ? o->nafter :
+                                                1, sizeof(size_t))) ||
+                                !(h->needs = calloc(o->nneeds ? o->nneeds :
+                                                1, sizeof(char *))))
+                        return 1;
+
+                for (; h->nafter < o->nafter; h->nafter++)
+                        h->after[h->nafter] = o->after[h->nafter];
+                for (; h->nneeds < o->nneeds; h->nneeds++)
+                        if (!(h->needs[h->nneeds] =
+                                                strdup(o->needs[h->nneeds])))
+                                return 1;
+                h->pending = h->nneeds;
+        }
+
+        return 0;
+}
+
+void p_hooks_written(struct p_hooks *hs, const char *rel)
+{
+        if (!hs || !hs->n || !rel)
+                return;
+
+        for (size_t i = 0; i < hs->n; i++) {
+                struct p_hook *h = &hs->h[i];
+                for (size_t j = 0; j < h->nneeds; j++) {
+                        if (h->needs[j] && !strcmp(h->needs[j], rel)) {
+                                free(h->needs[j]);
+                                h->needs[j] = NULL;
+                                h->pending--;
+                        }
+                }
+        }
+
+        p_hooks_schedule(hs);
+}
+
+int p_hooks_finish(struct p_hooks *hs)
+{
+        if (!hs || !hs->n)
+                return 0;
+
+        /* needs which were never written do not hold the hooks back */
+        hs->scaffolded = 1;
+        for (size_t i = 0; i < hs->n; i++)
+                hs->h[i].pending = 0;
+
+        for (;;) {
+                size_t c = p_hooks_schedule(hs);
+                if (!hs->running && !c)
+                        break;
+                if (!c && !p_hooks_reap(hs))
+                        p_hooks_wait(hs);
+        }
+
+        int f = 0;
+        for (size_t i = 0; i < hs->n; i++) {
+                struct p_hook *h = &hs->h[i];
+                if (h->state == HOOK_WAITING) {
+                        p_hooks_msg(hs, "Hook %s : skipped, circular %s\n",
+                                        h->name, HOOK_AFTER);
+                        h->state = HOOK_SKIPPED;
+                }
+                if (h->state != HOOK_DONE)
+                        f++;
+        }
+
+        return f;
+}
+
+void p_hooks_free(struct p_hooks *hs)
+{
+        if (!hs)
+                return;
+
+        for (size_t i = 0; i < hs->n; i++) {
+                struct p_hook *h = &hs->h[i];
+                free(h->name);
+                free(h->cmd);
+                free(h->after);
+                for (size_t j = 0; j < h->nneeds; j++)
+                        free(h->needs[j]);
+                free(h->needs);
+                if (h->out != -1)
+                        close(h->out);
+                if (h->pfd != -1)
+                        close(h->pfd);
+        }
+
+        free(hs->h);
+        free(hs->dir);
+        hs->h = NULL;
+        hs->dir = NULL;
+        hs->n = 0;
+}
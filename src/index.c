@@ -0,0 +1,372 @@
+/*
+ * @file 	index.c
+ * @author 	sb
+ * @brief 	source file for index header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+#include "../inc/index.h"
+
+/* static utility functions */
+static int p_index_add(struct p_index *x, const char *path)
+{
+        if (x->n == x->cap) {
+                size_t cap = x->cap ? x->cap * 2 : INDEX_CHUNK;
+                char **g = realloc(x->paths, cap * sizeof(char *));
+                if (!g)
+                        return 1;
+                x->paths = g;
+                x->cap = cap;
+        }
+
+        if (!(x->paths[x->n] = strdup(path)))
+                return 1;
+        x->n++;
+        return 0;
+}
+
+static int p_index_defer(char ***v, size_t *n, const char *name)
+{
+        char **g = realloc(*v, (*n + 1) * sizeof(char *));
+        if (!g)
+                return 1;
+        *v = g;
+        if (!(g[*n] = strdup(name)))
+                return 1;
+        (*n)++;
+        return 0;
+}
+
+static int p_index_walk(struct p_index *x, int rfd, int dfd, char *rel,
+                size_t rl, int depth)
+{
+        /*
+         * rel holds the path of dfd relative to the indexed root rfd and is
+         * extended in place for every entry. Down to INDEX_FDS levels every
+         * directory stays open while its children are walked; below that
+         * the children are only named, and reopened by their path from the
+         * root once the directory is closed, so any depth is indexed with
+         * a bounded number of descriptors
+         */
+        DIR *d = fdopendir(dfd);
+        if (!d) {
+                close(dfd);
+                return 1;
+        }
+
+        int r = 0;
+        char **later = NULL;
+        size_t nlater = 0;
+        struct dirent *de = NULL;
+        while (!r && (de = readdir(d))) {
+                if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+                        continue;
+
+                size_t nl = strlen(de->d_name);
+                if (rl + nl + 2 > PATH_MAX)
+                        continue;
+                memcpy(rel + rl, de->d_name, nl + 1);
+
+                struct stat s;
+                if (fstatat(dirfd(d), de->d_name, &s, AT_SYMLINK_NOFOLLOW))
+                        continue;
+
+                if (S_ISDIR(s.st_mode) && depth >= INDEX_FDS) {
+                        r = p_index_defer(&later, &nlater, de->d_name);
+                } else if (S_ISDIR(s.st_mode)) {
+                        /* a directory which can not be walked would leave
+                         * patterns quietly matching fewer files */
+                        int cfd = openat(dirfd(d), de->d_name,
+                                        O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+                        if (cfd == -1) {
+                                r = 1;
+                                break;
+                        }
+                        rel[rl + nl] = '/';
+                        rel[rl + nl + 1] = '\0';
+                        r = p_index_walk(x, rfd, cfd, rel, rl + nl + 1,
+                                        depth + 1);
+                } else if (S_ISREG(s.st_mode) || (S_ISLNK(s.st_mode) &&
+                                !fstatat(dirfd(d), de->d_name, &s, 0) &&
+                                S_ISREG(s.st_mode))) {
+                        r = p_index_add(x, rel);
+                }
+        }
+        int e = errno;
+        closedir(d);
+        errno = e;
+
+        for (size_t i = 0; i < nlater; i++) {
+                size_t nl = strlen(later[i]);
+                memcpy(rel + rl, later[i], nl);
+                rel[rl + nl] = '/';
+                rel[rl + nl + 1] = '\0';
+                int cfd = r ? -1 : openat(rfd, rel,
+                                O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+                if (cfd != -1)
+                        r = p_index_walk(x, rfd, cfd, rel, rl + nl + 1,
+                                        depth + 1);
+                else
+                        r = 1;
+                free(later[i]);
+        }
+        e = errno;
+        free(later);
+        errno = e;
+
+        rel[rl] = '\0';
+        return r;
+}
+
+static int p_index_cmp(const void *a, const void *b)
+{
+        return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static bool p_glob_class(const char **pp, char c)
+{
+        /* *pp points after the '[' and is moved past the closing ']' */
+        const char *p = *pp;
+        bool neg = false;
+        bool hit = false;
+
+        if (*p == '!' || *p == '^') {
+                neg = true;
+                p++;
+        }
+
+        for (bool first = true; *p && (first || *p != ']'); first = false) {
+                char lo = *p++;
+                char hi = lo;
+                if (*p == '-' && p[1] && p[1] != ']') {
+                        hi = p[1];
+                        p += 2;
+                }
+                if (lo <= c && c <= hi)
+                        hit = true;
+        }
+
+        if (*p == ']')
+                p++;
+        *pp = p;
+        return hit != neg;
+}
+
+/* header functions */
+int p_index_build(struct p_index *x, const char *root)
+{
+        if (!x || !root)
+                return 1;
+
+        x->paths = NULL;
+        x->n = 0;
+        x->cap = 0;
+
+        int dfd = open(root, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+        if (dfd == -1)
+                return 1;
+
+        /* kept for the directories below INDEX_FDS levels */
+        int rfd = fcntl(dfd, F_DUPFD_CLOEXEC, 0);
+        if (rfd == -1) {
+                close(dfd);
+                return 1;
+        }
+
+        char rel[PATH_MAX];
+        rel[0] = '\0';
+        int r = p_index_walk(x, rfd, dfd, rel, 0, 0);
+        int e = errno;
+        close(rfd);
+        if (r) {
+                p_index_free(x);
+                errno = e;
+                return 1;
+        }
+
+        /* sorted so that a literal prefix maps to one contiguous range */
+        qsort(x->paths, x->n, sizeof(char *), p_index_cmp);
+        return 0;
+}
+
+int p_index_list(struct p_index *x, const char * const *paths, size_t n)
+{
+        if (!x || (n && !paths))
+                return 1;
+
+        x->paths = NULL;
+        x->n = 0;
+        x->cap = 0;
+
+        for (size_t i = 0; i < n; i++) {
+                if (p_index_add(x, paths[i])) {
+                        p_index_free(x);
+                        return 1;
+                }
+        }
+
+        qsort(x->paths, x->n, sizeof(char *), p_index_cmp);
+        return 0;
+}
+
+int p_index_merge(struct p_index *x, const struct p_index *y)
+{
+        if (!x || !y)
+                return 1;
+
+        /* both are sorted, so one pass yields the sorted union */
+        size_t cap = x->n + y->n;
+        char **g = malloc((cap ? cap : 1) * sizeof(char *));
+        if (!g)
+                return 1;
+
+        size_t i = 0;
+        size_t j = 0;
+        size_t n = 0;
+        while (i < x->n || j < y->n) {
+                int c = i == x->n ? 1 : j == y->n ? -1 :
+                        strcmp(x->paths[i], y->paths[j]);
+                if (c > 0 && !(g[n] = strdup(y->paths[j]))) {
+                        /* only the copies made here are released */
+                        for (size_t k = 0, m = 0; k < n; k++)
+                                if (m < x->n && g[k] == x->paths[m])
+                                        m++;
+                                else
+                                        free(g[k]);
+                        free(g);
+                        return 1;
+                }
+                if (c <= 0)
+                        g[n] = x->paths[i++];
+                if (c >= 0)
+                        j++;
+                n++;
+        }
+
+        free(x->paths);
+        x->paths = g;
+        x->n = n;
+        x->cap = cap;
+        return 0;
+}
+
+void p_index_free(struct p_index *x)
+{
+        if (!x)
+                return;
+
+        for (size_t i = 0; i < x->n; i++)
+                free(x->paths[i]);
+        free(x->paths);
+        x->paths = NULL;
+        x->n = 0;
+        x->cap = 0;
+}
+
+bool p_is_glob(const char *s)
+{
+        return s && strpbrk(s, "*?[") != NULL;
+}
+
+bool p_glob_match(const char *pat, const char *s)
+{
+        while (*pat) {
+                if (pat[0] == '*' && pat[1] == '*' &&
+                                (pat[2] == '/' || pat[2] == '\0')) {
+                        /* '**' swallows zero or more whole directories */
+                        if (pat[2] == '\0')
+                                return true;
+                        pat += 3;
+                        for (;;) {
+                                if (p_glob_match(pat, s))
+                                        return true;
+                                if (!(s = strchr(s, '/')))
+                                        return false;
+                                s++;
+                        }
+                }
+
+                switch (*pat) {
+                        case '*':
+                                pat++;
+                                for (;;) {
+                                        if (p_glob_match(pat, s))
+                                                return true;
+                                        if (!*s || *s == '/')
+                                                return false;
+                                        s++;
+                                }
+                        case '?':
+                                if (!*s || *s == '/')
+                                        return false;
+                                pat++;
+                                s++;
+                                break;
+                        case '[':
+                                pat++;
+                                if (!*s || *s == '/' ||
+                                                !p_glob_class(&pat, *s))
+                                        return false;
+                                s++;
+                                break;
+                        default:
+                                if (*pat != *s)
+                                        return false;
+                                pat++;
+                                s++;
+                }
+        }
+
+        return *s == '\0';
+}
+
+size_t p_glob_dirlen(const char *pat)
+{
+        size_t m = strcspn(pat, "*?[");
+        size_t l = 0;
+
+        for (size_t i = 0; i < m; i++)
+                if (pat[i] == '/')
+                        l = i + 1;
+        return l;
+}
+
+size_t p_index_glob(const struct p_index *x, const char *pat,
+                void (*fn)(const char *path, void *arg), void *arg)
+{
+        if (!x || !pat || !fn)
+                return 0;
+
+        /* binary search for the first path carrying the literal prefix */
+        size_t pl = strcspn(pat, "*?[");
+        size_t lo = 0;
+        size_t hi = x->n;
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (strncmp(x->paths[mid], pat, pl) < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        size_t c = 0;
+        for (size_t i = lo; i < x->n && !strncmp(x->paths[i], pat, pl); i++) {
+                if (p_glob_match(pat, x->paths[i])) {
+                        fn(x->paths[i], arg);
+                        c++;
+                }
+        }
+
+        return c;
+}
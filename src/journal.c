@@ -0,0 +1,203 @@
+/*
+ * @file 	journal.c
+ * @author 	sb
+ * @brief 	source file for journal header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "../inc/journal.h"
+
+/* static utility functions */
+static int p_jent_cmp(const void *a, const void *b)
+{
+        const struct p_jent *x = a;
+        const struct p_jent *y = b;
+        int r = strcmp(x->path, y->path);
+        if (r)
+                return r;
+        return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static int p_journal_line(struct p_journal *j, const char *l)
+{
+        /* key size mtime.sec mtime.nsec path - anything else is skipped,
+         * such as the half written last line of a killed run */
+        unsigned long long key = 0;
+        long long size = 0;
+        long long sec = 0;
+        long nsec = 0;
+        int o = 0;
+        if (sscanf(l, "%16llx %lld %lld %ld %n", &key, &size, &sec, &nsec,
+                                &o) != 4 || !o || !l[o])
+                return 0;
+
+        if (j->n == j->cap) {
+                size_t cap = j->cap ? j->cap * 2 : JOURNAL_CHUNK;
+                struct p_jent *g = realloc(j->e, cap * sizeof(*g));
+                if (!g)
+                        return 1;
+                j->e = g;
+                j->cap = cap;
+        }
+
+        struct p_jent *e = &j->e[j->n];
+        if (!(e->path = strdup(l + o)))
+                return 1;
+        e->key = key;
+        e->size = size;
+        e->mtim.tv_sec = sec;
+        e->mtim.tv_nsec = nsec;
+        e->seq = j->n++;
+        return 0;
+}
+
+static int p_journal_load(struct p_journal *j, int fd)
+{
+        FILE *f = fdopen(fd, "r");
+        if (!f) {
+                close(fd);
+                return 1;
+        }
+
+        char *l = NULL;
+        size_t n = 0;
+        ssize_t r = 0;
+        int first = 1;
+        int ret = 0;
+        while (!ret && (r = getline(&l, &n, f)) != -1) {
+                /* a line without its newline was cut short */
+                if (r == 0 || l[r - 1] != '\n')
+                        break;
+                if (first) {
+                        first = 0;
+                        if (strcmp(l, JOURNAL_MAGIC))
+                                break;
+                        continue;
+                }
+                l[r - 1] = '\0';
+                ret = p_journal_line(j, l);
+        }
+
+        free(l);
+        fclose(f);
+        qsort(j->e, j->n, sizeof(struct p_jent), p_jent_cmp);
+        return ret;
+}
+
+static int p_journal_path(char *buf, const char *root)
+{
+        int r = snprintf(buf, PATH_MAX, "%s/%s", root, JOURNAL_FILE);
+        return r < 0 || r >= PATH_MAX;
+}
+
+/* header functions */
+int p_journal_open(struct p_journal *j, int dfd, const char *root,
+                int resume)
+{
+        j->fd = -1;
+        j->e = NULL;
+        j->n = 0;
+        j->cap = 0;
+
+        char jp[PATH_MAX];
+        if (!root || p_journal_path(jp, root))
+                return 1;
+
+        int r = 0;
+        if (resume) {
+                int fd = openat(dfd, jp, O_RDONLY | O_CLOEXEC);
+                if (fd == -1 && errno != ENOENT)
+                        return 1;
+                if (fd == -1)
+                        r = 2;
+                else if (p_journal_load(j, fd))
+                        return 1;
+        }
+
+        /* lines are only ever appended, one write each, so a killed run
+         * leaves at most its last line incomplete */
+        int fl = O_WRONLY | O_CLOEXEC | O_CREAT | O_APPEND |
+                (r || !resume ? O_TRUNC : 0);
+        if ((j->fd = openat(dfd, jp, fl, 0644)) == -1)
+                return 1;
+        if ((r || !resume) && write(j->fd, JOURNAL_MAGIC,
+                                strlen(JOURNAL_MAGIC)) == -1)
+                return 1;
+
+        return r;
+}
+
+int p_journal_done(const struct p_journal *j, const char *rel, uint64_t key,
+                const struct stat *ds)
+{
+        if (!j || !j->n || !rel || !ds)
+                return 0;
+
+        /* the last entry of the path decides */
+        size_t lo = 0;
+        size_t hi = j->n;
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (strcmp(j->e[mid].path, rel) <= 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        if (!lo || strcmp(j->e[lo - 1].path, rel))
+                return 0;
+
+        const struct p_jent *e = &j->e[lo - 1];
+        return e->key == key && S_ISREG(ds->st_mode) &&
+                e->size == ds->st_size &&
+                e->mtim.tv_sec == ds->st_mtim.tv_sec &&
+                e->mtim.tv_nsec == ds->st_mtim.tv_nsec;
+}
+
+int p_journal_add(struct p_journal *j, const char *rel, uint64_t key,
+                const struct stat *ds)
+{
+        if (!j || j->fd == -1 || !rel || !ds)
+                return 1;
+
+        char l[PATH_MAX + 96];
+        int n = snprintf(l, sizeof(l), "%016llx %lld %lld %ld %s\n",
+                        (unsigned long long)key, (long long)ds->st_size,
+                        (long long)ds->st_mtim.tv_sec, ds->st_mtim.tv_nsec,
+                        rel);
+        if (n < 0 || n >= (int)sizeof(l))
+                return 1;
+
+        return write(j->fd, l, n) != n;
+}
+
+void p_journal_close(struct p_journal *j, int dfd, const char *root,
+                int done)
+{
+        if (!j)
+                return;
+
+        if (j->fd != -1)
+                close(j->fd);
+        j->fd = -1;
+
+        char jp[PATH_MAX];
+        if (done && root && !p_journal_path(jp, root))
+                unlinkat(dfd, jp, 0);
+
+        for (size_t i = 0; i < j->n; i++)
+                free(j->e[i].path);
+        free(j->e);
+        j->e = NULL;
+        j->n = 0;
+        j->cap = 0;
+}
@@ -1,5 +1,142 @@
 #include "../inc/jsmn.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+	!defined(JSMN_SCALAR)
+#define JSMN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Block scanners used to skip the bytes which carry no structure. A scanner
+ * returns the offset of the first byte at or after pos which it stops on,
+ * or len when there is none. The vector versions only classify whole blocks
+ * inside [pos, len) and leave the tail to the scalar loop.
+ */
+typedef size_t (*jsmn_scan_fn)(const char *js, size_t pos, size_t len);
+
+typedef struct {
+	jsmn_scan_fn string;	/* stops on '"', '\\' or NUL */
+	jsmn_scan_fn space;	/* stops on anything but whitespace */
+} jsmn_scanner;
+
+static size_t jsmn_string_scalar(const char *js, size_t pos, size_t len) {
+	for (; pos < len; pos++) {
+		char c = js[pos];
+		if (c == '\"' || c == '\\' || c == '\0')
+			break;
+	}
+	return pos;
+}
+
+static size_t jsmn_space_scalar(const char *js, size_t pos, size_t len) {
+	for (; pos < len; pos++) {
+		char c = js[pos];
+		if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+			break;
+	}
+	return pos;
+}
+
+#ifdef JSMN_X86
+__attribute__((target("sse2")))
+static size_t jsmn_string_sse2(const char *js, size_t pos, size_t len) {
+	const __m128i q = _mm_set1_epi8('\"');
+	const __m128i b = _mm_set1_epi8('\\');
+	const __m128i z = _mm_setzero_si128();
+	for (; pos + 16 <= len; pos += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(js + pos));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q),
+					_mm_cmpeq_epi8(v, b)), _mm_cmpeq_epi8(v, z));
+		unsigned int bits = (unsigned int)_mm_movemask_epi8(m);
+		if (bits)
+			return pos + __builtin_ctz(bits);
+	}
+	return jsmn_string_scalar(js, pos, len);
+}
+
+__attribute__((target("sse2")))
+static size_t jsmn_space_sse2(const char *js, size_t pos, size_t len) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i tb = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i nl = _mm_set1_epi8('\n');
+	for (; pos + 16 <= len; pos += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(js + pos));
+		__m128i m = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tb)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, nl)));
+		unsigned int bits = ~(unsigned int)_mm_movemask_epi8(m) & 0xffffu;
+		if (bits)
+			return pos + __builtin_ctz(bits);
+	}
+	return jsmn_space_scalar(js, pos, len);
+}
+
+#ifndef JSMN_NO_AVX2
+__attribute__((target("avx2")))
+static size_t jsmn_string_avx2(const char *js, size_t pos, size_t len) {
+	const __m256i q = _mm256_set1_epi8('\"');
+	const __m256i b = _mm256_set1_epi8('\\');
+	const __m256i z = _mm256_setzero_si256();
+	for (; pos + 32 <= len; pos += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(js + pos));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(
+					_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, b)),
+				_mm256_cmpeq_epi8(v, z));
+		unsigned int bits = (unsigned int)_mm256_movemask_epi8(m);
+		if (bits)
+			return pos + __builtin_ctz(bits);
+	}
+	return jsmn_string_sse2(js, pos, len);
+}
+
+__attribute__((target("avx2")))
+static size_t jsmn_space_avx2(const char *js, size_t pos, size_t len) {
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i tb = _mm256_set1_epi8('\t');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i nl = _mm256_set1_epi8('\n');
+	for (; pos + 32 <= len; pos += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(js + pos));
+		__m256i m = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+					_mm256_cmpeq_epi8(v, tb)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+					_mm256_cmpeq_epi8(v, nl)));
+		unsigned int bits = ~(unsigned int)_mm256_movemask_epi8(m);
+		if (bits)
+			return pos + __builtin_ctz(bits);
+	}
+	return jsmn_space_sse2(js, pos, len);
+}
+#endif
+#endif
+
+/**
+ * The widest scanner the running CPU supports, picked once when the program
+ * is loaded. JSMN_SCALAR forces the byte at a time loops, JSMN_NO_AVX2 stops
+ * at SSE2 - test/jsmn builds every one of them to hold the block scanners
+ * against the loops.
+ */
+static jsmn_scanner jsmn_scan = { jsmn_string_scalar, jsmn_space_scalar };
+
+#ifdef JSMN_X86
+__attribute__((constructor))
+static void jsmn_select_scanner(void) {
+	__builtin_cpu_init();
+#ifndef JSMN_NO_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		jsmn_scan.string = jsmn_string_avx2;
+		jsmn_scan.space = jsmn_space_avx2;
+	} else
+#endif
+	if (__builtin_cpu_supports("sse2")) {
+		jsmn_scan.string = jsmn_string_sse2;
+		jsmn_scan.space = jsmn_space_sse2;
+	}
+}
+#endif
+
 /**
  * Allocates a fresh unused token from the token pool.
  */
@@ -82,7 +219,8 @@ found:
  * Fills next token with JSON string.
  */
 static int jsmn_parse_string(jsmn_parser *parser, const char *js,
-		size_t len, jsmntok_t *tokens, size_t num_tokens) {
+		size_t len, jsmntok_t *tokens, size_t num_tokens,
+		jsmn_scan_fn scan) {
 	jsmntok_t *token;
 
 	int start = parser->pos;
@@ -91,7 +229,13 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 
 	/* Skip starting quote */
 	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
-		char c = js[parser->pos];
+		char c;
+
+		/* Jump over the plain characters in blocks */
+		parser->pos = scan(js, parser->pos, len);
+		if (parser->pos >= len || js[parser->pos] == '\0')
+			break;
+		c = js[parser->pos];
 
 		/* Quote: end of string */
 		if (c == '\"') {
@@ -154,11 +298,20 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 	int i;
 	jsmntok_t *token;
 	int count = parser->toknext;
+	jsmn_scanner scan = jsmn_scan;
 
 	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
 		char c;
 		jsmntype_t type;
 
+		/* Runs of whitespace between tokens are skipped in blocks */
+		c = js[parser->pos];
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			parser->pos = scan.space(js, parser->pos, len);
+			if (parser->pos >= len || js[parser->pos] == '\0')
+				break;
+		}
+
 		c = js[parser->pos];
 		switch (c) {
 			case '{': case '[':
@@ -229,7 +382,8 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 #endif
 				break;
 			case '\"':
-				r = jsmn_parse_string(parser, js, len, tokens, num_tokens);
+				r = jsmn_parse_string(parser, js, len, tokens, num_tokens,
+						scan.string);
 				if (r < 0) return r;
 				count++;
 				if (parser->toksuper != -1 && tokens != NULL)
@@ -13,15 +13,10 @@
 
 int main(int argc, char *argv[])
 {
-	if (argc < MIN_ARGS || argc > MAX_ARGS) {
+	if (argc < MIN_ARGS) {
 		printf("Error in number of arguments\n");
 		p_display_usage();
 		exit(EXIT_FAILURE);
-	} else if ((argc == MIN_ARGS && strcmp(argv[MIN_ARGS - 1], "-t") == 0)
-			|| (argc == MIN_ARGS + 1)) {
-		printf("Expected project type and project name\n");
-		p_display_usage();
-		exit(EXIT_FAILURE);
 	}
 
 	/* decrement the arg count so that we do not handle the name of the
@@ -38,49 +33,69 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
         }
 
-	/* count till argc drops */
-	while (argc--) {
-		if (p_parse_flags(*argv, &p))
-                        exit(EXIT_FAILURE);
+	/* flags may come before, between or after the project names, which
+	 * are gathered at the front of argv - everything after "--" is a
+	 * name, even when it starts with '-' */
+	int n = 0;
+	bool opts = true;
+	for (int i = 0; i < argc; i++) {
+		if (!opts || *argv[i] != '-') {
+			argv[n++] = argv[i];
+			continue;
+		}
+		if (strcmp(argv[i], "--") == 0) {
+			opts = false;
+			continue;
+		}
 
-		argv++;
+		if (p_parse_flags(argv[i], &p))
+                        exit(EXIT_FAILURE);
 		if (p.rdp_t) {
-			if (p_assign_ptype(*argv, &p)) {
-                                perror("p_assign_ptype failed");
+			if (++i == argc || p_assign_ptype(argv[i], &p)) {
+                                printf("Expected project type after -t\n");
                                 exit(EXIT_FAILURE);
                         }
 			p.rdp_t = false;
-
-			/* point to the project name and then exit the loop */
-			argv++;
-			break;
 		}
 	}
+	argc = n;
+
+	if (!p.pt || argc < 1) {
+		printf("Expected project type and project name\n");
+		p_display_usage();
+		p_free_res(&p);
+		exit(EXIT_FAILURE);
+	}
+
+	struct p_env e;
+	if (p_env_init(&e)) {
+		p_env_free(&e);
+		p_free_res(&p);
+		exit(EXIT_FAILURE);
+	}
 
 	/*
 	 * Before going ahead with getting the details from the CLI arguments
-	 * check if the .config directory exists or not.
-	 * Add the function in the project module
+	 * check if the .config directory exists or not and bootstrap the
+	 * resource directory - both are skipped once everything is in place,
+	 * or when the templates come from the system wide store
 	 */
-	p_check_parent_dir();
-
-	/* fixme: Add the code for copying the resource directory to the
-	 * mkproject directory under ~/.config */
-	p_copy_resources();
+	if (!e.resd && !e.ready && !e.sysd) {
+		p_check_parent_dir(&e);
+		p_copy_resources(&e);
+	}
 
-        /* need a return type from this function */
-	if (p_get_resd_loc(&p)) {
-                /* failure case - dummy file has been created without any
-                 * configuration data */
-                printf("Configuration file has been created -"
-                                " empty content\n");
+	if (p_get_resd_loc(&e, &p)) {
+                /* the configuration file holds no resource directory - the
+                 * help has been printed and there is nothing to create */
         } else {
                 /* configuration file exists already - may have configuration
                  * data */
-                p.pdn = strdup(*argv);
-                p_mkproject(&p);
+                p_mkprojects(&p, argv, argc);
         }
 
+	int r = p.err ? EXIT_FAILURE : EXIT_SUCCESS;
+	p_env_free(&e);
 	p_free_res(&p);
-	return 0;
+	return r;
 }
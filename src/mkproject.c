@@ -0,0 +1,254 @@
+/*
+ * @file 	mkproject.c
+ * @author 	sb
+ * @brief 	source file for mkproject header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+#include "../inc/mkproject.h"
+#include "../inc/project.h"
+#include "../inc/verify.h"
+
+/* structure */
+struct mkp_template {
+        char *js;               /* template text */
+        char *resd;             /* resource directory, NULL in memory */
+        char *sysd;             /* system wide store, NULL if none */
+        char *pt;               /* project type - directory of the files */
+        struct mkp_file *files; /* in-memory files sorted by path */
+        size_t nfiles;
+};
+
+static const char *mkp_errs[] = {
+        [MKP_OK] = "success",
+        [MKP_EINVAL] = "invalid argument",
+        [MKP_ENOMEM] = "out of memory",
+        [MKP_ECONFIG] = "no resource directory configured",
+        [MKP_ETEMPLATE] = "template missing or not proper",
+        [MKP_ESOURCE] = "file of the template missing",
+        [MKP_EEXIST] = "project directory exists",
+        [MKP_EWRITE] = "project could not be written",
+        [MKP_EGIT] = "git repository could not be written",
+        [MKP_ESYNC] = "project could not be synced to disk",
+        [MKP_EHOOK] = "hook failed",
+        [MKP_EVERIFY] = "project differs from its template"
+};
+
+/* static utility functions */
+static char *mkp_read(const char *fp)
+{
+        int fd = open(fp, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+                return NULL;
+
+        struct stat s;
+        char *b = NULL;
+        if (fstat(fd, &s) == 0 && (b = malloc(s.st_size + 1))) {
+                off_t n = 0;
+                while (n < s.st_size) {
+                        ssize_t r = read(fd, b + n, s.st_size - n);
+                        if (r == -1 && errno == EINTR)
+                                continue;
+                        if (r <= 0)
+                                break;
+                        n += r;
+                }
+                b[n] = '\0';
+        }
+
+        close(fd);
+        return b;
+}
+
+static int mkp_file_cmp(const void *a, const void *b)
+{
+        return strcmp(((const struct mkp_file *)a)->path,
+                        ((const struct mkp_file *)b)->path);
+}
+
+/* header functions */
+void mkp_options_init(struct mkp_options *o)
+{
+        if (!o)
+                return;
+
+        long c = sysconf(_SC_NPROCESSORS_ONLN);
+        o->update = 0;
+        o->resume = 0;
+        o->git = 0;
+        o->durability = 0;
+        o->verify = 0;
+        o->jobs = c > 0 ? c : 1;
+        o->with = NULL;
+        o->out = NULL;
+}
+
+int mkp_template_load(struct mkp_template **t, const char *resd,
+                const char *type)
+{
+        if (!t || !resd || !type || !*type)
+                return MKP_EINVAL;
+        *t = NULL;
+
+        struct mkp_template *m = calloc(1, sizeof(struct mkp_template));
+        size_t n = strlen(resd);
+        if (!m || !(m->resd = calloc(n + 2, sizeof(char))) ||
+                        !(m->pt = strdup(type))) {
+                mkp_template_free(m);
+                return MKP_ENOMEM;
+        }
+        strcat(m->resd, resd);
+        if (n && resd[n - 1] != '/')
+                strcat(m->resd, "/");
+
+        /* the same layers as the command line - the resource directory
+         * shadows the system wide store */
+        m->sysd = p_system_dir();
+        char fp[PATH_MAX];
+        snprintf(fp, PATH_MAX, "%s%s%s", m->resd, type, RES_EXTENSION);
+        if (!(m->js = mkp_read(fp)) && errno == ENOENT && m->sysd) {
+                snprintf(fp, PATH_MAX, "%s%s%s", m->sysd, type,
+                                RES_EXTENSION);
+                m->js = mkp_read(fp);
+        }
+        if (!m->js) {
+                int r = errno == ENOMEM ? MKP_ENOMEM : MKP_ETEMPLATE;
+                mkp_template_free(m);
+                return r;
+        }
+
+        *t = m;
+        return MKP_OK;
+}
+
+int mkp_template_mem(struct mkp_template **t, const char *json, size_t n,
+                const struct mkp_file *files, size_t nfiles)
+{
+        if (!t || !json || (nfiles && !files))
+                return MKP_EINVAL;
+        *t = NULL;
+
+        struct mkp_template *m = calloc(1, sizeof(struct mkp_template));
+        if (!m || !(m->js = strndup(json, n)) || !(m->files =
+                                calloc(nfiles ? nfiles : 1,
+                                        sizeof(struct mkp_file)))) {
+                mkp_template_free(m);
+                return MKP_ENOMEM;
+        }
+
+        for (size_t i = 0; i < nfiles; i++) {
+                struct mkp_file *f = &m->files[i];
+                void *d = malloc(files[i].size ? files[i].size : 1);
+                if (!files[i].path || (files[i].size && !files[i].data)) {
+                        free(d);
+                        mkp_template_free(m);
+                        return MKP_EINVAL;
+                }
+                if (!d || !(f->path = strdup(files[i].path))) {
+                        free(d);
+                        mkp_template_free(m);
+                        return MKP_ENOMEM;
+                }
+                if (files[i].size)
+                        memcpy(d, files[i].data, files[i].size);
+                f->data = d;
+                f->size = files[i].size;
+                f->mode = files[i].mode ? files[i].mode : 0644;
+                m->nfiles++;
+        }
+
+        /* looked up with a binary search for every build_files entry */
+        qsort(m->files, m->nfiles, sizeof(struct mkp_file), mkp_file_cmp);
+        *t = m;
+        return MKP_OK;
+}
+
+void mkp_template_free(struct mkp_template *t)
+{
+        if (!t)
+                return;
+
+        for (size_t i = 0; i < t->nfiles; i++) {
+                free((char *)t->files[i].path);
+                free((void *)t->files[i].data);
+        }
+        free(t->files);
+        free(t->js);
+        free(t->resd);
+        free(t->sysd);
+        free(t->pt);
+        free(t);
+}
+
+int mkp_create(const struct mkp_template *t, int dirfd, const char *name,
+                const struct mkp_options *o)
+{
+        struct mkp_options d;
+        if (!o) {
+                mkp_options_init(&d);
+                o = &d;
+        }
+
+        if (!t || !name || !*name || o->durability < 0 ||
+                        o->durability > 2)
+                return MKP_EINVAL;
+
+        /* an existing directory is only written into when updating or
+         * resuming, otherwise it can only be verified */
+        struct stat s;
+        int v = o->verify ? VERIFY_AFTER : VERIFY_NONE;
+        if (fstatat(dirfd, name, &s, 0) == 0) {
+                if (!S_ISDIR(s.st_mode))
+                        return MKP_EEXIST;
+                if (!(o->update || o->resume)) {
+                        if (!o->verify)
+                                return MKP_EEXIST;
+                        v = VERIFY_ONLY;
+                }
+        }
+
+        struct project p;
+        p_setup(&p);
+        p.upd = o->update;
+        p.resume = o->resume;
+        p.mkgit = o->git;
+        p.durable = o->durability;
+        p.verify = v;
+        if (o->jobs > 0)
+                p.jobs = o->jobs;
+        p.with = o->with;
+        p.dfd = dirfd;
+        p.out = o->out;
+        p.mem = t->files;
+        p.nmem = t->nfiles;
+
+        /* the template stays untouched, so threads can share it */
+        if (!(p.pdn = strdup(name)) ||
+                        (t->pt && !(p.pt = strdup(t->pt))) ||
+                        (t->resd && !(p.resd = strdup(t->resd))) ||
+                        (t->sysd && !(p.sysd = strdup(t->sysd)))) {
+                p_free_res(&p);
+                return MKP_ENOMEM;
+        }
+
+        p_parse_jsdata(t->js, &p);
+
+        int r = p.code ? p.code : p.err ? MKP_EWRITE : MKP_OK;
+        p_free_res(&p);
+        return r;
+}
+
+const char *mkp_strerror(int code)
+{
+        if (code < 0 || code > MKP_EVERIFY)
+                return "unknown status";
+        return mkp_errs[code];
+}
@@ -0,0 +1,299 @@
+/*
+ * @file 	plan.c
+ * @author 	sb
+ * @brief 	source file for plan header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <linux/limits.h>
+#include "../inc/plan.h"
+
+/* an empty file has nothing to map */
+static const char p_plan_empty[1];
+
+/* static utility functions */
+static char *p_plan_move(const char *path, size_t n, const char *root)
+{
+        size_t r = strlen(root);
+        char *d = malloc(r + strlen(path + n) + 1);
+        if (d) {
+                memcpy(d, root, r);
+                strcpy(d + r, path + n);
+        }
+        return d;
+}
+
+static int p_plan_layout(int dfd, const char *path, int dir, int *exists)
+{
+        /*
+         * a missing path is made later, anything else in the way of it is
+         * an error now - a component which is a file shows up as ENOTDIR
+         */
+        struct stat s;
+        *exists = 0;
+        if (fstatat(dfd, path, &s, 0) == -1)
+                return errno == ENOENT ? 0 : errno;
+        *exists = 1;
+        if (dir && !S_ISDIR(s.st_mode))
+                return ENOTDIR;
+        if (!dir && S_ISDIR(s.st_mode))
+                return EISDIR;
+        return 0;
+}
+
+/* header functions */
+void p_plan_init(struct p_plan *pl)
+{
+        memset(pl, 0, sizeof(*pl));
+}
+
+int p_plan_dir(struct p_plan *pl, const char *path)
+{
+        if (!pl || !path)
+                return 1;
+
+        if (pl->nd == pl->capd) {
+                size_t c = pl->capd ? pl->capd * 2 : PLAN_CHUNK;
+                struct p_pdir *d = realloc(pl->d, c * sizeof(*d));
+                if (!d)
+                        return 1;
+                pl->d = d;
+                pl->capd = c;
+        }
+
+        struct p_pdir *d = &pl->d[pl->nd];
+        if (!(d->path = strdup(path)))
+                return 1;
+        d->err = 0;
+        pl->nd++;
+        return 0;
+}
+
+int p_plan_file(struct p_plan *pl, const char *dest, const char *src,
+                const struct mkp_file *m)
+{
+        if (!pl || !dest || !src)
+                return 1;
+
+        if (pl->nf == pl->capf) {
+                size_t c = pl->capf ? pl->capf * 2 : PLAN_CHUNK;
+                struct p_pent *f = realloc(pl->f, c * sizeof(*f));
+                if (!f)
+                        return 1;
+                pl->f = f;
+                pl->capf = c;
+        }
+
+        struct p_pent *f = &pl->f[pl->nf];
+        memset(f, 0, sizeof(*f));
+        if (!(f->dest = strdup(dest)) || !(f->src = strdup(src))) {
+                free(f->dest);
+                return 1;
+        }
+        f->m = m;
+        pl->nf++;
+        return 0;
+}
+
+size_t p_plan_check(struct p_plan *pl, int rfd, int sfd, int dfd,
+                unsigned long long *need, unsigned long long *nodes)
+{
+        size_t e = 0;
+        unsigned long long n = 0;
+        unsigned long long k = 0;
+        off_t big = 0;
+
+        for (size_t i = 0; i < pl->nd; i++) {
+                struct p_pdir *d = &pl->d[i];
+                int x = 0;
+                if ((d->err = p_plan_layout(dfd, d->path, 1, &x)))
+                        e++;
+                else if (!x)
+                        k++;
+        }
+
+        for (size_t i = 0; i < pl->nf; i++) {
+                struct p_pent *f = &pl->f[i];
+                struct stat s;
+
+                /* the sources are stat'ed relative to the type directory,
+                 * without resolving its path again for every file - the
+                 * overrides first, then the system layer */
+                int r = -1;
+                errno = ENOENT;
+                if (!f->m && !f->map && rfd != -1)
+                        r = fstatat(rfd, f->src, &s, 0);
+                if (!f->m && !f->map && r == -1 && errno == ENOENT &&
+                                sfd != -1) {
+                        r = fstatat(sfd, f->src, &s, 0);
+                        f->sys = 1;
+                }
+
+                if (f->m) {
+                        f->size = f->m->size;
+                } else if (f->map) {
+                        f->size = f->st.st_size;
+                } else if (r == -1) {
+                        f->serr = errno;
+                } else if (!S_ISREG(s.st_mode)) {
+                        f->serr = EISDIR;
+                } else {
+                        f->size = s.st_size;
+                }
+
+                f->derr = p_plan_layout(dfd, f->dest, 0, &f->exists);
+                if (f->serr || f->derr) {
+                        e++;
+                        continue;
+                }
+
+                /* an existing file is replaced through a temporary file,
+                 * the largest one decides the room needed for it */
+                if (f->exists) {
+                        if (f->size > big)
+                                big = f->size;
+                        continue;
+                }
+                n += f->size;
+                k++;
+        }
+
+        *need = n + big;
+        *nodes = k + (big != 0);
+        return e;
+}
+
+size_t p_plan_map(struct p_plan *pl, int rfd, int sfd)
+{
+        size_t c = 0;
+
+        for (size_t i = 0; i < pl->nf; i++) {
+                struct p_pent *f = &pl->f[i];
+                if (f->m || f->map || f->serr)
+                        continue;
+
+                int fd = openat(f->sys ? sfd : rfd, f->src,
+                                O_RDONLY | O_CLOEXEC);
+                if (fd == -1)
+                        continue;
+                void *m = MAP_FAILED;
+                if (fstat(fd, &f->st) == 0 && S_ISREG(f->st.st_mode))
+                        m = f->st.st_size ? mmap(NULL, f->st.st_size,
+                                        PROT_READ, MAP_PRIVATE, fd, 0) :
+                                (void *)p_plan_empty;
+                close(fd);
+                if (m == MAP_FAILED)
+                        continue;
+
+                f->map = m;
+                f->size = f->st.st_size;
+                c++;
+        }
+
+        return c;
+}
+
+int p_plan_rebase(struct p_plan *pl, size_t n, const char *root)
+{
+        if (!pl || !root)
+                return 1;
+
+        for (size_t i = 0; i < pl->nd; i++) {
+                struct p_pdir *d = &pl->d[i];
+                char *p = p_plan_move(d->path, n, root);
+                if (!p)
+                        return 1;
+                free(d->path);
+                d->path = p;
+                d->err = 0;
+        }
+
+        for (size_t i = 0; i < pl->nf; i++) {
+                struct p_pent *f = &pl->f[i];
+                char *p = p_plan_move(f->dest, n, root);
+                if (!p)
+                        return 1;
+                free(f->dest);
+                f->dest = p;
+                f->exists = 0;
+                f->derr = 0;
+
+                /* a source which is not mapped is checked again */
+                if (!f->m && !f->map) {
+                        f->sys = 0;
+                        f->size = 0;
+                        f->serr = 0;
+                }
+        }
+
+        return 0;
+}
+
+int p_plan_space(int dfd, const char *root, unsigned long long need,
+                unsigned long long nodes, unsigned long long *avail)
+{
+        char dp[PATH_MAX];
+        snprintf(dp, PATH_MAX, "%s", root);
+
+        /* the project directory or the nearest parent of it which exists */
+        int fd = -1;
+        while ((fd = openat(dfd, dp, O_RDONLY | O_CLOEXEC |
+                                        O_DIRECTORY)) == -1) {
+                if (errno != ENOENT || !strcmp(dp, ".") || !strcmp(dp, "/"))
+                        return -1;
+                char *sl = strrchr(dp, '/');
+                while (sl && sl != dp && sl[1] == '\0') {
+                        *sl = '\0';
+                        sl = strrchr(dp, '/');
+                }
+                if (!sl)
+                        snprintf(dp, PATH_MAX, ".");
+                else if (sl == dp)
+                        snprintf(dp, PATH_MAX, "/");
+                else
+                        *sl = '\0';
+        }
+
+        struct statvfs v;
+        int r = fstatvfs(fd, &v);
+        close(fd);
+        if (r == -1)
+                return -1;
+
+        *avail = (unsigned long long)v.f_bavail * v.f_frsize;
+        if (need + nodes * v.f_frsize > *avail)
+                return 1;
+        if (v.f_files && nodes > v.f_favail)
+                return 1;
+        return 0;
+}
+
+void p_plan_free(struct p_plan *pl)
+{
+        if (!pl)
+                return;
+
+        for (size_t i = 0; i < pl->nd; i++)
+                free(pl->d[i].path);
+        for (size_t i = 0; i < pl->nf; i++) {
+                struct p_pent *f = &pl->f[i];
+                free(f->dest);
+                free(f->src);
+                if (f->map && f->map != p_plan_empty)
+                        munmap((void *)f->map, f->st.st_size);
+        }
+        free(pl->d);
+        free(pl->f);
+}
@@ -10,38 +10,74 @@
 #endif
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <dirent.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/sendfile.h>
+#include <time.h>
 #include <unistd.h>
-#include <ftw.h>
 #include <fcntl.h>
 #include <linux/limits.h>
 #include "../inc/project.h"
 #include "../inc/version.h"
+#include "../inc/store.h"
+#include "../inc/index.h"
+#include "../inc/hooks.h"
+#include "../inc/git.h"
+#include "../inc/durable.h"
+#include "../inc/dirs.h"
+#include "../inc/journal.h"
+#include "../inc/verify.h"
+#include "../inc/plan.h"
+#include "../inc/clone.h"
 
 /* static utility functions */
-static bool p_dir_exists(const char *filepath)
+static void p_msg(const struct project *p, const char *fmt, ...)
+{
+        /* every message of a run goes through here - the command line
+         * prints to stdout while an embedding caller may ask for silence */
+        if (!p->out)
+                return;
+
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(p->out, fmt, ap);
+        va_end(ap);
+}
+
+static void p_fail(struct project *p, int code, const char *fmt, ...)
+{
+        /* the first failure decides the status of the whole run */
+        if (!p->code)
+                p->code = code;
+        p->err++;
+
+        if (!p->out)
+                return;
+
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(p->out, fmt, ap);
+        va_end(ap);
+}
+
+static bool p_dir_exists(int dfd, const char *filepath)
 {
         /*
          * return false of the directory needs to be created
          * return true if the directory already exists
          */
-        DIR *dir = opendir(filepath);
-        if (!dir && ENOENT == errno) {
-                closedir(dir);
+        struct stat s;
+        if (fstatat(dfd, filepath, &s, 0) == -1 && ENOENT == errno)
                 return false;
-        }
 
-        closedir(dir);
         return true;
 }
 
 static void p_write_file(const char * filepath, const char * d)
 {
-        FILE *f = fopen(filepath, "w");
+        FILE *f = fopen(filepath, "we");
 
         if (d)
                 fwrite(d, strlen(d), sizeof(char), f);
@@ -49,18 +85,6 @@ static void p_write_file(const char * filepath, const char * d)
         fclose(f);
 }
 
-static off_t p_get_filesize(const char * restrict filepath)
-{
-        struct stat s;
-        int r = 0;
-        if ((r = stat(filepath, &s)) != 0) {
-                perror("Error with stat");
-                return r;
-        }
-
-        return s.st_size;
-}
-
 static void p_display_config_help(void)
 {
         printf("\nConfiguration can be added in the following way : \n");
@@ -69,10 +93,8 @@ static void p_display_config_help(void)
                         "res_dir_location=<absolute_path>/res/\n\n");
 }
 
-static char *p_read_config(const char * restrict fp)
+static char *p_read_config(FILE *f)
 {
-        FILE *f = fopen(fp, "r");
-
         if (!f) {
                 perror("fopen : couldn't open file - check filepath");
                 return NULL;
@@ -81,16 +103,17 @@ static char *p_read_config(const char * restrict fp)
         char *c = NULL;
         char *ret = NULL;
         char *tok = NULL;
+        char *sp = NULL;
         size_t n = 0;
         while(getline(&c, &n, f) != -1) {
                 if (*c != '#') {
-                        tok = strtok(c, CONFIG_DELIM);
+                        tok = strtok_r(c, CONFIG_DELIM, &sp);
                         /* after reaching the first proper line - break out */
                         break;
                 }
         }
 
-        for (int f = 0; tok; tok = strtok(NULL, CONFIG_DELIM)) {
+        for (int f = 0; tok; tok = strtok_r(NULL, CONFIG_DELIM, &sp)) {
                 if (strcmp(tok, CONFIG_VAR) == 0) {
                         f = 1;
                 } else if (f) {
@@ -100,109 +123,853 @@ static char *p_read_config(const char * restrict fp)
         }
 
         free(c);
-        fclose(f);
 
         return ret;
 }
 
-static int p_create_dir(const char *dp)
+static int p_create_dir(int dfd, const char *dp)
 {
         if (!dp) {
-                printf("Dir path has not been provided\n");
+                errno = EINVAL;
                 return -1;
         }
-        return mkdir(dp, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        return mkdirat(dfd, dp, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 }
 
 static char *p_read_file(const char * restrict fp, char *buf)
 {
-        FILE *f = fopen(fp, "r");
-        if (!f) {
-                char errl[MAXLEN];
-                memset(errl, 0, MAXLEN * sizeof(char));
-                sprintf(errl, "%s template file doesn't exist", fp);
-                perror(errl);
+        /* NULL with errno set on failure, the caller reports it */
+        int fd = open(fp, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
                 return NULL;
+
+        /* size the buffer from the open descriptor and read it in one go */
+        struct stat s;
+        if (fstat(fd, &s) == -1 || !(buf = malloc(s.st_size + 1))) {
+                int e = errno;
+                close(fd);
+                errno = e;
+                return NULL;
+        }
+
+        off_t n = 0;
+        while (n < s.st_size) {
+                ssize_t r = read(fd, buf + n, s.st_size - n);
+                if (r == -1 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        break;
+                n += r;
         }
+        buf[n] = '\0';
 
-        buf = calloc(p_get_filesize(fp) + 1, sizeof(char));
+        close(fd);
+        return buf;
+}
 
-        char *t = NULL;
-        ssize_t nread = 0;
+/* a template entry being installed - a file of the resource directory or a
+ * buffer of an in-memory template */
+struct p_src {
+        int fd;                 /* -1 for a buffer */
+        const void *d;          /* contents of a buffer */
+        struct stat st;         /* size, mode and, for files, times */
+        int map;                /* d is a mapped file, known by its stat */
+};
+
+static int p_write_all(int fd, const void *d, size_t n)
+{
+        const char *c = d;
+
+        while (n) {
+                ssize_t r = write(fd, c, n);
+                if (r == -1 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return -1;
+                c += r;
+                n -= r;
+        }
+
+        return 0;
+}
+
+static int p_same_content(const struct p_src *s, int dfd)
+{
+        /*
+         * 1 -> both hash to the same value
+         * 0 -> contents differ or could not be read
+         */
+        uint64_t a = 0;
+        uint64_t b = 0;
+
+        if (lseek(dfd, 0, SEEK_SET) == -1 || p_hash_fd(dfd, &b) == -1)
+                return 0;
+        if (s->fd == -1)
+                a = p_hash_buf(s->d, s->st.st_size);
+        else if (lseek(s->fd, 0, SEEK_SET) == -1 ||
+                        p_hash_fd(s->fd, &a) == -1)
+                return 0;
+        return a == b;
+}
+
+static int p_write_src(const struct p_src *s, int dfd)
+{
+        /* a file shares its blocks on a CoW filesystem, or is copied in
+         * the kernel otherwise */
+        if (s->fd == -1)
+                return p_write_all(dfd, s->d, s->st.st_size);
+        if (lseek(s->fd, 0, SEEK_SET) == -1)
+                return -1;
+        if (p_store_clone(s->fd, dfd) == 0)
+                return 0;
+        return p_store_copy_fd(s->fd, dfd, s->st.st_size);
+}
+
+static int p_open_tmp(const struct project *p, const char *dest, char *tp)
+{
+        /* mkstemp has no *at variant, so the unique name is made here -
+         * the address of tp differs between threads */
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        unsigned int r = ts.tv_nsec ^ (unsigned int)getpid() ^
+                (unsigned int)(uintptr_t)tp;
+
+        for (int i = 0; i < UPDATE_TMP_TRIES; i++) {
+                r = r * 1103515245u + 12345u;
+                snprintf(tp, PATH_MAX, "%s%s%08x", dest, UPDATE_TMP, r);
+                int fd = openat(p->dfd, tp, O_RDWR | O_CLOEXEC | O_CREAT |
+                                O_EXCL, 0600);
+                if (fd != -1 || errno != EEXIST)
+                        return fd;
+        }
+
+        return -1;
+}
+
+static int p_update_file(struct project * restrict p, const struct p_src *s,
+                const char *dest)
+{
+        /*
+         * 0 -> destination is up to date (rewritten or already unchanged)
+         * -1 -> failure, the old destination is left as it was
+         */
+        struct stat ds;
+        if (fstatat(p->dfd, dest, &ds, 0) == 0 && S_ISREG(ds.st_mode) &&
+                        ds.st_size == s->st.st_size) {
+                /* the times say nothing about the content - a project
+                 * built since has newer objects than any template file */
+                int dfd = openat(p->dfd, dest, O_RDONLY | O_CLOEXEC);
+                int same = dfd != -1 && p_same_content(s, dfd);
+                if (dfd != -1)
+                        close(dfd);
+                if (same)
+                        return 0;
+        }
+
+        /* write next to the destination and rename over it so that an
+         * interrupted update never leaves a truncated file behind */
+        char tp[PATH_MAX];
+        int tfd = p_open_tmp(p, dest, tp);
+        if (tfd == -1) {
+                p_fail(p, MKP_EWRITE, "%s : unable to create temporary file"
+                                " - %s\n", dest, strerror(errno));
+                return -1;
+        }
+
+        /* a rewritten file keeps the time it is written at, so make
+         * rebuilds whatever depends on it */
+        int r = p_write_src(s, tfd);
+        if (r == 0 && fchmod(tfd, p_store_mode(s->st.st_mode)) == -1)
+                r = -1;
+        /* synced before the rename, so the new name never points to data
+         * which is not on disk yet */
+        if (r == 0 && p_durable_file(p->dur, tfd, dest))
+                r = -1;
+        close(tfd);
+
+        if (r == -1 || renameat(p->dfd, tp, p->dfd, dest) == -1) {
+                p_fail(p, MKP_EWRITE, "%s : unable to replace file - %s\n",
+                                dest, strerror(errno));
+                unlinkat(p->dfd, tp, 0);
+                return -1;
+        }
+
+        p_msg(p, "Updated : %s\n", dest);
+        return 0;
+}
+
+static uint64_t p_key(const void *d, const struct stat *st)
+{
+        /* a buffer is hashed, a file is known by its size and times */
+        if (d)
+                return p_hash_buf(d, st->st_size);
+
+        int64_t k[4] = { st->st_size, st->st_mtim.tv_sec,
+                st->st_mtim.tv_nsec, st->st_ino };
+        return p_hash_buf(k, sizeof(k));
+}
+
+static uint64_t p_src_key(const struct p_src *s)
+{
+        return p_key(s->fd == -1 && !s->map ? s->d : NULL, &s->st);
+}
+
+static void p_copy_src(struct project * restrict p, const struct p_src *s,
+                const char *dest)
+{
+        /* path of the file inside the project, as the repository sees it */
+        const char *rel = dest + strlen(p->pdn) + 1;
+
+        /* a file an interrupted run completed needs nothing but a stat,
+         * an update checks every file anyway */
+        uint64_t key = 0;
+        struct stat ds;
+        if (p->jrn && p->jrn->n) {
+                key = p_src_key(s);
+                if (fstatat(p->dfd, dest, &ds, 0) == 0 &&
+                                p_journal_done(p->jrn, rel, key, &ds)) {
+                        if (p->git && p_git_add_file(p->git, rel))
+                                p_fail(p, MKP_EGIT, "%s : unable to add to "
+                                                "git\n", dest);
+                        return;
+                }
+        }
+
+        if (p->upd) {
+                if (p_update_file(p, s, dest) == 0 && p->git &&
+                                p_git_add_file(p->git, rel))
+                        p_fail(p, MKP_EGIT, "%s : unable to add to git\n",
+                                        dest);
+                return;
+        }
+
+        int dfd = openat(p->dfd, dest, O_WRONLY | O_CLOEXEC | O_CREAT |
+                        O_TRUNC, 0666);
+        if (dfd == -1) {
+                p_fail(p, MKP_EWRITE, "%s : %s\n", dest, strerror(errno));
+                return;
+        }
+        (void)fchmod(dfd, p_store_mode(s->st.st_mode));
+
+        /* with a repository the file is copied through the blob it is
+         * stored as, otherwise it is cloned or copied in the kernel */
+        int r = 0;
+        int gr = 0;
+        if (!p->git) {
+                r = p_write_src(s, dfd);
+        } else if (s->fd != -1) {
+                gr = p_git_copy(p->git, rel, s->fd, dfd, s->st.st_size);
+                r = gr == -1 ? -1 : 0;
+        } else if ((r = p_write_all(dfd, s->d, s->st.st_size)) == 0) {
+                gr = fstat(dfd, &ds) || p_git_add(p->git, rel, s->d,
+                                s->st.st_size, &ds);
+        }
+
+        if (r == -1)
+                p_fail(p, MKP_EWRITE, "%s : unable to write - %s\n", dest,
+                                strerror(errno));
+        else if (gr)
+                p_fail(p, MKP_EGIT, "%s : unable to add to git\n", dest);
+
+        if (r == 0 && p_durable_file(p->dur, dfd, dest))
+                p_fail(p, MKP_ESYNC, "%s : unable to sync\n", dest);
+
+        /* recorded once the data is written, and synced if asked for */
+        if (r == 0 && p->jrn && (fstat(dfd, &ds) ||
+                                p_journal_add(p->jrn, rel, p->jrn->n ? key :
+                                        p_src_key(s), &ds)))
+                p_msg(p, "%s : unable to journal\n", dest);
+
+        if (close(dfd) && r == 0)
+                p_fail(p, MKP_EWRITE, "%s : %s\n", dest, strerror(errno));
+}
+
+static jsmntok_t *p_tokenize(const char *s, size_t n, int *nt)
+{
+        /*
+         * the token array grows whenever jsmn runs out of tokens and the
+         * parse resumes where it stopped, so the text is scanned once
+         * instead of being counted first and parsed afterwards
+         */
+        unsigned int cap = TOKEN_CHUNK;
+        jsmntok_t *t = NULL;
+        jsmn_parser jp;
+        jsmn_init(&jp);
+
+        for (;;) {
+                jsmntok_t *g = realloc(t, cap * sizeof(jsmntok_t));
+                if (!g) {
+                        free(t);
+                        *nt = JSMN_ERROR_NOMEM;
+                        return NULL;
+                }
+                t = g;
+
+                *nt = jsmn_parse(&jp, s, n, t, cap);
+                if (*nt != JSMN_ERROR_NOMEM)
+                        return t;
+                cap *= 2;
+        }
+}
+
+static int p_token_value(const char *jsd, const jsmntok_t *t, int nt, int o,
+                const char *tok_name)
+{
+        /* only the keys of the object at o are looked at, -1 when none of
+         * them is tok_name */
+        if (o < 0 || o >= nt || t[o].type != JSMN_OBJECT)
+                return -1;
+
+        int i = o + 1;
+        for (int k = 0; k < t[o].size && i + 1 < nt; k++) {
+                if (p_jsoneq(jsd, (jsmntok_t *)&t[i], tok_name) == 0)
+                        return i + 1;
+                i = p_skip_token(t, i + 1);
+        }
+
+        return -1;
+}
+
+static int p_make_dirs(struct project * restrict p, const char *path)
+{
+        /* the set lives as long as the project, so every prefix is created
+         * or checked once however many entries and projects share it */
+        if (!p->dirs) {
+                if (!(p->dirs = malloc(sizeof(struct p_dirs)))) {
+                        p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                        return -1;
+                }
+                p_dirs_init(p->dirs);
+        }
+
+        if (p_dirs_make(p->dirs, p->dfd, path) == 0)
+                return 0;
+        p_fail(p, MKP_EWRITE, "%s : %s\n", path, strerror(errno));
+        return -1;
+}
+
+static int p_make_parent(struct project * restrict p, char *path)
+{
+        /* the directory holding the file at path */
+        char *sl = strrchr(path, '/');
+        if (!sl)
+                return 0;
+
+        *sl = '\0';
+        int r = p_make_dirs(p, path);
+        *sl = '/';
+        return r;
+}
+
+static int p_mem_cmp(const void *a, const void *b)
+{
+        return strcmp(((const struct mkp_file *)a)->path,
+                        ((const struct mkp_file *)b)->path);
+}
+
+static int p_copy_contents(const struct p_env *e, struct p_dirs *d,
+                const char *objd, const char *rel)
+{
+        char src[PATH_MAX];
+        char cl[PATH_MAX];
+        snprintf(src, PATH_MAX, "%s/%s", RESD_LOC_MASTER, rel);
+        snprintf(cl, PATH_MAX, "%s%s", e->rl, rel);
+
+        char *sl = strrchr(cl, '/');
+        *sl = '\0';
+        int r = p_dirs_make(d, AT_FDCWD, cl);
+        *sl = '/';
+        if (r) {
+                printf("Unable to create the directory of %s\n", cl);
+                return -1;
+        }
+
+        /* the file body goes into the object store once and every
+         * template referring to the same content shares that object */
+        char hex[HASH_HEX_LEN + 1];
+        if (p_store_put(objd, src, hex) || p_store_link(objd, hex, cl)) {
+                printf("Unable to store %s\n", src);
+                return -1;
+        }
+
+        return 0;
+}
+
+static char *p_hooks_dir(const struct project * restrict p)
+{
+        /*
+         * hooks run in a shell which only knows paths - a project below a
+         * directory descriptor is reached through the path of that
+         * descriptor
+         */
+        if (p->dfd == AT_FDCWD || *p->pdn == '/')
+                return strdup(p->pdn);
+
+        char fl[64];
+        char dp[PATH_MAX];
+        snprintf(fl, sizeof(fl), "/proc/self/fd/%d", p->dfd);
+        ssize_t n = readlink(fl, dp, sizeof(dp) - 1);
+        if (n <= 0)
+                return NULL;
+        dp[n] = '\0';
+
+        char *d = malloc(n + strlen(p->pdn) + 2);
+        if (d)
+                sprintf(d, "%s/%s", dp, p->pdn);
+        return d;
+}
+
+static void p_plan_install(struct project * restrict p, const char *sk,
+                const char *v, const char *dk)
+{
+        /*
+         * sk is the path of the source below <resd>/<pt>/ and dk the path of
+         * the destination below the project directory or its v directory
+         */
+        char dest[PATH_MAX];
+        int b = 0;
+
+        if (!strcmp(v, ROOT_DIR))
+                b = snprintf(dest, PATH_MAX, "%s/", p->pdn);
+        else
+                b = snprintf(dest, PATH_MAX, "%s/%s/", p->pdn, v);
+        snprintf(dest + b, PATH_MAX - b, "%s", dk);
+
+        /* in-memory templates are sorted by path once */
+        const struct mkp_file *m = NULL;
+        if (p->mem) {
+                struct mkp_file k = { sk, NULL, 0, 0 };
+                m = bsearch(&k, p->mem, p->nmem, sizeof(struct mkp_file),
+                                p_mem_cmp);
+                if (!m) {
+                        p_fail(p, MKP_ESOURCE, "%s : not in the template\n",
+                                        sk);
+                        return;
+                }
+        }
+
+        if (p_plan_file(p->plan, dest, sk, m))
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+}
+
+static void p_copy_at(struct project * restrict p, int fd, const char *src,
+                const char *dest)
+{
+        /*
+         * implement the checks whether the source file exists or not
+         * if it doesn't - report it and go on with the next one
+         */
+        struct p_src s;
+        memset(&s, 0, sizeof(s));
+        s.fd = openat(fd, src, O_RDONLY | O_CLOEXEC);
+        if (s.fd == -1 || fstat(s.fd, &s.st) == -1) {
+                p_fail(p, MKP_ESOURCE, "%s : %s\n", src, strerror(errno));
+                if (s.fd != -1)
+                        close(s.fd);
+                return;
+        }
+
+        p_copy_src(p, &s, dest);
+        close(s.fd);
+}
+
+static void p_src_path(const struct project * restrict p,
+                const struct p_pent *f, char *b)
+{
+        /* the layer the preflight found the source in */
+        snprintf(b, PATH_MAX, "%s%s/%s", f->sys ? p->sysd : p->resd, p->pt,
+                        f->src);
+}
+
+static void p_verify_entry(struct project * restrict p,
+                const struct p_pent *f)
+{
+        /* a source in memory is hashed from there */
+        char src[PATH_MAX];
+        const void *d = f->m ? f->m->data : f->map;
+        size_t n = f->m ? f->m->size : f->map ? (size_t)f->st.st_size : 0;
+        if (!d)
+                p_src_path(p, f, src);
+        if (p->vfy && p_verify_add(p->vfy, f->dest, d ? NULL : src, d, n))
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+}
+
+static void p_installed(struct project * restrict p, const struct p_pent *f)
+{
+        p_verify_entry(p, f);
+
+        /* hooks waiting on this file can start while the rest is copied */
+        if (p->hooks)
+                p_hooks_written(p->hooks, f->dest + strlen(p->pdn) + 1);
+}
+
+static void p_install_file(struct project * restrict p, struct p_pent *f)
+{
+        /* the v directory and any directory of dk are made on demand */
+        int w = p->verify != VERIFY_ONLY;
+        if (w && p_make_parent(p, f->dest))
+                return;
+
+        int e = p->err;
+        if (f->m || f->map) {
+                struct p_src s;
+                memset(&s, 0, sizeof(s));
+                s.fd = -1;
+                if (f->map) {
+                        s.d = f->map;
+                        s.st = f->st;
+                        s.map = 1;
+                } else {
+                        s.d = f->m->data;
+                        s.st.st_size = f->m->size;
+                        s.st.st_mode = f->m->mode;
+                }
+                if (w)
+                        p_copy_src(p, &s, f->dest);
+        } else if (w) {
+                p_copy_at(p, f->sys ? p->sfd : p->rfd, f->src, f->dest);
+        }
+
+        /* a file which failed to be written has been reported already */
+        if (p->err == e)
+                p_installed(p, f);
+}
+
+struct p_clone_ctx {
+        struct project *p;      /* project being created */
+        struct p_cjob *j;       /* first job, to find the plan entry */
+        struct p_pent **f;      /* plan entry of every job */
+};
+
+static void p_clone_done(struct p_cjob *j, void *arg)
+{
+        /*
+         * called on the thread which wrote the file, one at a time - the
+         * file is journaled and its hooks are started before the rest of
+         * the tree is finished, so a killed run can resume from here
+         */
+        struct p_clone_ctx *c = arg;
+        struct project *p = c->p;
+        if (j->serr || j->derr)
+                return;
+
+        /* the thread synced the data, its directories are synced last */
+        errno = 0;
+        if (!j->yerr && p_durable_path(p->dur, j->dest))
+                j->yerr = errno ? errno : ENOMEM;
+        if (j->yerr)
+                return;
+
+        /* only the buffer of an in-memory template is hashed */
+        const char *rel = j->dest + strlen(p->pdn) + 1;
+        uint64_t key = p_key(c->f[j - c->j]->m ? j->d : NULL, &j->st);
+        if (p->jrn && p_journal_add(p->jrn, rel, key, &j->ds))
+                p_msg(p, "%s : unable to journal\n", j->dest);
+        if (p->hooks)
+                p_hooks_written(p->hooks, rel);
+}
+
+static int p_clone_ok(const struct project * restrict p)
+{
+        /*
+         * a plain creation only writes bytes, which the threads can do on
+         * their own - every file is synced by the thread writing it, and
+         * the journal, the hooks and the durability are told about it as
+         * it is finished, anything else keeping state per file stays
+         * serial
+         */
+        return p->jobs > 1 && p->plan->nf > 1 && !p->git && !p->upd &&
+                !(p->jrn && p->jrn->n) && p->verify != VERIFY_ONLY;
+}
+
+static void p_clone_files(struct project * restrict p)
+{
+        struct p_plan *pl = p->plan;
+        struct p_cjob *j = calloc(pl->nf, sizeof(struct p_cjob));
+        struct p_pent **f = calloc(pl->nf, sizeof(struct p_pent *));
+        if (!j || !f) {
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                free(j);
+                free(f);
+                return;
+        }
+
+        /* every directory is made first, the threads only write files */
         size_t n = 0;
+        for (size_t i = 0; i < pl->nf; i++) {
+                struct p_pent *e = &pl->f[i];
+                if (p_make_parent(p, e->dest))
+                        continue;
+                f[n] = e;
+                j[n].dest = e->dest;
+                if (e->m) {
+                        j[n].d = e->m->data;
+                        j[n].mode = e->m->mode;
+                        j[n].st.st_size = e->m->size;
+                } else if (e->map) {
+                        j[n].d = e->map;
+                        j[n].mode = e->st.st_mode;
+                        j[n].st = e->st;
+                } else {
+                        j[n].rfd = e->sys ? p->sfd : p->rfd;
+                        j[n].src = e->src;
+                }
+                n++;
+        }
 
-        while ((nread = getline(&t, &n, f)) != -1)
-                buf = strcat(buf, t);
+        struct p_clone_ctx c = { p, j, f };
+        p_clone_tree(j, n, p->dfd, p->jobs, p->dur, p_clone_done, &c);
+
+        /* failures are reported in the order of the template */
+        char src[PATH_MAX];
+        for (size_t i = 0; i < n; i++) {
+                if (j[i].serr) {
+                        p_src_path(p, f[i], src);
+                        p_fail(p, MKP_ESOURCE, "%s : %s\n", src,
+                                        strerror(j[i].serr));
+                        continue;
+                }
+                if (j[i].derr) {
+                        p_fail(p, MKP_EWRITE, "%s : unable to write - %s\n",
+                                        j[i].dest, strerror(j[i].derr));
+                        continue;
+                }
+                if (j[i].yerr) {
+                        p_fail(p, MKP_ESYNC, "%s : unable to sync\n",
+                                        j[i].dest);
+                        continue;
+                }
+                p_verify_entry(p, f[i]);
+        }
 
-        free(t);
-        fclose(f);
-        return buf;
+        free(j);
+        free(f);
 }
 
-static int p_copy_contents(const char* fpath,const struct stat*sb,int tflag)
+static void p_preflight(struct project * restrict p)
 {
-	/* fixme: check if the file referred is a directory or not */
-	if (S_ISDIR(sb->st_mode)) {
-		if (strcmp(fpath, RESD_LOC_MASTER)) {
-			char *token = strtok((char *)fpath, "..");
+        /* the sources are stat'ed against the type directories, opened
+         * once and kept for the copy - either layer may lack the type */
+        char td[PATH_MAX] = "";
+        char sd[PATH_MAX] = "";
+        int ufd = p->rfd != AT_FDCWD ? p->rfd : -1;
+        if (!p->mem) {
+                snprintf(td, PATH_MAX, "%s%s", p->resd, p->pt);
+                if (p->sysd)
+                        snprintf(sd, PATH_MAX, "%s%s", p->sysd, p->pt);
+        }
 
-			char *h = getenv(USER_HOME);
-			char cl[PATH_MAX];
-			memset(cl, '\0', PATH_MAX);
-			strcat(cl, h);
-			strcat(cl, CONFIG_LOC);
-			strcat(cl, token);
+        /* a kept template has them open from its first project */
+        if (!p->mem && ufd == -1 && p->sfd == -1) {
+                if ((ufd = open(td, O_RDONLY | O_CLOEXEC | O_DIRECTORY)) != -1)
+                        p->rfd = ufd;
+                int r = errno;
+                if (p->sysd)
+                        p->sfd = open(sd, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+                if (ufd == -1 && p->sfd == -1) {
+                        p_fail(p, MKP_ESOURCE, "%s : %s\n", td, strerror(r));
+                        return;
+                }
+        }
 
-			p_create_dir(cl);
-		}
-	} else {
-		char token[PATH_MAX];
-		memset(token, '\0', PATH_MAX);
-		p_strsplice(fpath, token, 3, strlen(fpath));
-		//char *token = strtok((char *)fpath, "..");
-
-		char *h = getenv(USER_HOME);
-		char cl[PATH_MAX];
-		memset(cl, '\0', PATH_MAX);
-		strcat(cl, h);
-		strcat(cl, CONFIG_LOC);
-		strcat(cl, token);
+        unsigned long long need = 0;
+        unsigned long long nodes = 0;
+        struct p_plan *pl = p->plan;
+        size_t e = p_plan_check(pl, ufd, p->sfd, p->dfd, &need, &nodes);
+
+        /* every further project is written from the same pages */
+        if (p->fan)
+                p_plan_map(pl, ufd, p->sfd);
+
+        /* every problem is reported, not only the first one */
+        for (size_t i = 0; e && i < pl->nd; i++)
+                if (pl->d[i].err)
+                        p_fail(p, MKP_EWRITE, "%s : %s\n", pl->d[i].path,
+                                        strerror(pl->d[i].err));
+        for (size_t i = 0; e && i < pl->nf; i++) {
+                const struct p_pent *f = &pl->f[i];
+                if (f->serr)
+                        p_fail(p, MKP_ESOURCE, "%s/%s : %s\n",
+                                        f->sys ? sd : td, f->src,
+                                        strerror(f->serr));
+                if (f->derr)
+                        p_fail(p, MKP_EWRITE, "%s : %s\n", f->dest,
+                                        strerror(f->derr));
+        }
 
+        unsigned long long avail = 0;
+        if (p_plan_space(p->dfd, p->pdn, need, nodes, &avail) == 1)
+                p_fail(p, MKP_EWRITE, "%s : %llu bytes in %llu entries "
+                                "needed, %llu bytes available\n", p->pdn,
+                                need, nodes, avail);
+}
 
-		int source, destination;
-		if ((source = open(fpath, O_RDONLY)) == -1) {
-			printf("Unable to open file\n");
-			return -1;
-		}
-		if ((destination = creat(cl, 0660)) == -1) {
-			printf("Unable to create file at destination\n");
-			close(destination);
-			return -1;
-		}
+static void p_build(struct project * restrict p)
+{
+        struct p_plan *pl = p->plan;
+        struct stat ds;
+
+        for (size_t i = 0; i < pl->nd; i++) {
+                /* nested entries need no parents listed before them */
+                if (p->verify != VERIFY_ONLY)
+                        p_make_dirs(p, pl->d[i].path);
+                else if (fstatat(p->dfd, pl->d[i].path, &ds, 0) == -1 ||
+                                !S_ISDIR(ds.st_mode))
+                        p_fail(p, MKP_EVERIFY, "Missing : %s/\n",
+                                        pl->d[i].path);
+        }
 
-		struct stat fileinfo = {0};
-		fstat(source, &fileinfo);
-		if (sendfile(destination, source, NULL, fileinfo.st_size)
-				== -1) {
-			fprintf(stderr, "ERROR : Unable to sendfile\n");
-			return -1;
-		}
+        if (p_clone_ok(p)) {
+                p_clone_files(p);
+                return;
+        }
+
+        for (size_t i = 0; i < pl->nf; i++)
+                p_install_file(p, &pl->f[i]);
+}
+
+static struct p_index *p_build_index(struct project * restrict p)
+{
+        struct p_index *x = malloc(sizeof(struct p_index));
+        if (x && p->mem) {
+                const char **n = malloc((p->nmem + 1) * sizeof(char *));
+                for (size_t i = 0; n && i < p->nmem; i++)
+                        n[i] = p->mem[i].path;
+                if (n && !p_index_list(x, n, p->nmem)) {
+                        free(n);
+                        return x;
+                }
+                free(n);
+                p_fail(p, MKP_ENOMEM, "Unable to index the template\n");
+                free(x);
+                return NULL;
+        }
+
+        /* the overrides and the system layer are indexed as one tree -
+         * either may lack the type, but one which has it and can not be
+         * walked whole fails the index */
+        char root[PATH_MAX];
+        snprintf(root, PATH_MAX, "%s%s/", p->resd, p->pt);
+        int u = x ? p_index_build(x, root) : 1;
+        int ue = u ? errno : 0;
+        struct p_index y;
+        char sr[PATH_MAX];
+        if (x && p->sysd && (!u || ue == ENOENT)) {
+                snprintf(sr, PATH_MAX, "%s%s/", p->sysd, p->pt);
+                int se = p_index_build(&y, sr) ? errno : 0;
+                if (se && se != ENOENT) {
+                        p_fail(p, MKP_ESOURCE, "%s : unable to index "
+                                        "resource directory - %s\n", sr,
+                                        strerror(se));
+                        if (!u)
+                                p_index_free(x);
+                        free(x);
+                        return NULL;
+                } else if (se) {
+                        /* the overrides may hold the whole type */
+                } else if (u) {
+                        *x = y;
+                        u = 0;
+                } else if (p_index_merge(x, &y)) {
+                        p_fail(p, MKP_ENOMEM, "Unable to index the "
+                                        "template\n");
+                        p_index_free(&y);
+                        p_index_free(x);
+                        free(x);
+                        return NULL;
+                } else {
+                        p_index_free(&y);
+                }
+        }
+
+        if (!x || u) {
+                p_fail(p, MKP_ESOURCE, "%s : unable to index resource "
+                                "directory - %s\n", root, strerror(ue));
+                free(x);
+                return NULL;
+        }
+
+        return x;
+}
+
+struct p_glob_ctx {
+        struct project *p;	/* project being created */
+        const char *v;		/* destination directory of the pattern */
+        size_t dl;		/* literal directory part of the pattern */
+};
+
+static void p_glob_install(const char *path, void *arg)
+{
+        /* the part of the match below the literal directory of the
+         * pattern is recreated under the destination */
+        struct p_glob_ctx *g = arg;
+        p_plan_install(g->p, path, g->v, path + g->dl);
+}
+
+static void p_verify_report(struct project * restrict p)
+{
+        /* hashed in parallel, reported in the order of the template */
+        struct p_verify *v = p->vfy;
+        p_verify_run(v, p->jobs);
+
+        size_t d = 0;
+        size_t m = 0;
+        for (size_t i = 0; i < v->n; i++) {
+                const struct p_vent *e = &v->e[i];
+                switch (e->state) {
+                        case VERIFY_DIFFER:
+                                p_fail(p, MKP_EVERIFY, "Mismatch : %s\n",
+                                                e->dest);
+                                d++;
+                                break;
+                        case VERIFY_MISSING:
+                                p_fail(p, MKP_EVERIFY, "Missing : %s\n",
+                                                e->dest);
+                                m++;
+                                break;
+                        case VERIFY_EREAD:
+                                p_fail(p, MKP_EVERIFY, "%s : %s\n", e->dest,
+                                                strerror(e->err));
+                                break;
+                        case VERIFY_ESOURCE:
+                                p_fail(p, MKP_ESOURCE, "%s : %s\n", e->src,
+                                                strerror(e->err));
+                                break;
+                        default:
+                                break;
+                }
+        }
 
-		close(source);
-		close(destination);
-	}
-	return 0;
+        p_msg(p, "Verified %zu files : %zu mismatched, %zu missing\n", v->n,
+                        d, m);
 }
 
 /* header functions */
 void p_display_usage(void)
 {
         printf("Usage of the program:\n"
-                        "<program> -t <type> <name_of_project>\n"
+                        "<program> -t <type> <name_of_project>...\n"
                         "-t		type of the project\n"
                         "-v		display version information\n"
                         "-h		display help information\n"
                         "-c		display config file help information\n"
+                        "--update	rewrite only the files of an existing "
+                        "project that differ from the template\n"
+                        "--jobs=N	run at most N hooks or hashing threads "
+                        "at a time\n"
+                        "--git		initialize a git repository with the "
+                        "scaffold as its first commit\n"
+                        "--resume	continue the scaffold of an interrupted "
+                        "run\n"
+                        "--verify	check the files of the project against "
+                        "the template\n"
+                        "--with=a,b	add the optional extras a and b of "
+                        "the template\n"
+                        "--durability=none|batch|strict\n"
+                        "		sync the scaffold to disk before "
+                        "returning\n"
+                        "--		end of options, the names after it may "
+                        "start with '-'\n"
                         "For example, in order to create a C project\n"
                         "mkproject -t c c_project_name\n");
 }
@@ -218,24 +985,105 @@ int p_setup(struct project * restrict p)
                 return 1;
         }
 
-        p->rdp_t = false;
-        p->pt = NULL;
-        p->resd = NULL;
-        p->pdn = NULL;
-
-        return 0;
-}
+        p->rdp_t = false;
+        p->pt = NULL;
+        p->resd = NULL;
+        p->sysd = NULL;
+        p->pdn = NULL;
+        p->upd = false;
+        p->idx = NULL;
+        p->hooks = NULL;
+        p->mkgit = false;
+        p->git = NULL;
+        p->durable = DURABLE_NONE;
+        p->dur = NULL;
+        p->dfd = AT_FDCWD;
+        p->mem = NULL;
+        p->nmem = 0;
+        p->dirs = NULL;
+        p->resume = false;
+        p->jrn = NULL;
+        p->verify = VERIFY_NONE;
+        p->vfy = NULL;
+        p->plan = NULL;
+        p->rfd = AT_FDCWD;
+        p->sfd = -1;
+        p->with = NULL;
+        p->fan = 0;
+        p->hspec = NULL;
+        p->out = stdout;
+        p->code = MKP_OK;
+        p->err = 0;
+
+        long c = sysconf(_SC_NPROCESSORS_ONLN);
+        p->jobs = c > 0 ? c : 1;
+
+        return 0;
+}
+
+int p_parse_flags(const char * restrict s, struct project * restrict p)
+{
+        /*
+         * 0 -> success
+         * 1 -> failure
+         */
+        if (!p || (strlen(s) != FLAG_LEN && strncmp(s, "--", 2))) {
+                printf("Length of arg_str is not proper or the "
+                                "project structure instance not provided\n");
+                return 1;
+        }
+
+        if (!strcmp(s, FLAG_UPDATE)) {
+                p->upd = true;
+                return 0;
+        }
+
+        if (!strcmp(s, FLAG_RESUME)) {
+                p->resume = true;
+                return 0;
+        }
+
+        if (!strcmp(s, FLAG_VERIFY)) {
+                p->verify = VERIFY_AFTER;
+                return 0;
+        }
+
+        if (!strcmp(s, FLAG_GIT)) {
+                p->mkgit = true;
+                return 0;
+        }
+
+        if (!strncmp(s, FLAG_DURABLE, strlen(FLAG_DURABLE))) {
+                int m = p_durable_parse(s + strlen(FLAG_DURABLE));
+                if (m == -1) {
+                        printf("Durability has to be one of none, batch or "
+                                        "strict\n");
+                        return 1;
+                }
+                p->durable = m;
+                return 0;
+        }
+
+        if (!strncmp(s, FLAG_WITH, strlen(FLAG_WITH))) {
+                if (!*(s + strlen(FLAG_WITH))) {
+                        printf("Extras have to be named, for example "
+                                        "--with=bench\n");
+                        return 1;
+                }
+                p->with = s + strlen(FLAG_WITH);
+                return 0;
+        }
 
-int p_parse_flags(const char * restrict s, struct project * restrict p)
-{
-        /*
-         * 0 -> success
-         * 1 -> failure
-         */
-        if (strlen(s) != FLAG_LEN || !p) {
-                printf("Length of arg_str is not proper or the "
-                                "project structure instance not provided\n");
-                return 1;
+        if (!strncmp(s, FLAG_JOBS, strlen(FLAG_JOBS))) {
+                char *e = NULL;
+                long j = strtol(s + strlen(FLAG_JOBS), &e, 10);
+                if (j < 1 || *e) {
+                        printf("Number of jobs has to be a positive "
+                                        "number\n");
+                        return 1;
+                }
+                p->jobs = j;
+                return 0;
         }
 
         if (*s == '-')
@@ -279,13 +1127,26 @@ int p_assign_ptype(const char * restrict s, struct project * restrict p)
 
 void p_free_res(struct project * restrict p)
 {
-        if (!p) {
-                printf("Project struct instance not provided\n");
-                exit(EXIT_FAILURE);
-        }
+        if (!p)
+                return;
 
         /* new fields */
+        p_index_free(p->idx);
+        free(p->idx);
+        p_dirs_free(p->dirs);
+        free(p->dirs);
+        p_verify_free(p->vfy);
+        free(p->vfy);
+        p_plan_free(p->plan);
+        free(p->plan);
+        p_hooks_free(p->hspec);
+        free(p->hspec);
+        if (p->rfd != AT_FDCWD)
+                close(p->rfd);
+        if (p->sfd != -1)
+                close(p->sfd);
         free(p->resd);
+        free(p->sysd);
         free(p->pt);
         free(p->pdn);
 }
@@ -297,8 +1158,8 @@ int p_check_config_dir(const char *cl)
          */
         int r = 0;
 
-        if (!p_dir_exists(cl)) {
-                if (p_create_dir(cl) != 0) {
+        if (!p_dir_exists(AT_FDCWD, cl)) {
+                if (p_create_dir(AT_FDCWD, cl) != 0) {
                         r = 0;
                 }
         } else {
@@ -308,61 +1169,85 @@ int p_check_config_dir(const char *cl)
         return r;
 }
 
-int p_get_resd_loc(struct project * restrict p)
+int p_get_resd_loc(struct p_env * restrict e, struct project * restrict p)
 {
-        char *h = getenv(USER_HOME);
-        char *cl = calloc(strlen(h) + strlen(CONFIG_LOC) + 1, sizeof(char));
-        cl = strcat(cl, h);
-        cl = strcat(cl, CONFIG_LOC);
+        /* the system layer sits beneath whichever directory is resolved */
+        if (e->sysd && !(p->sysd = strdup(e->sysd)))
+                return 1;
+
+        /* the environment override needs neither the config directory nor
+         * the config file */
+        if (e->resd) {
+                size_t n = strlen(e->resd);
+                p->resd = calloc(n + 2, sizeof(char));
+                strcat(p->resd, e->resd);
+                if (n && e->resd[n - 1] != '/')
+                        strcat(p->resd, "/");
+                return 0;
+        }
 
-        if (p_check_config_dir(cl) == 1) {
+        /* with a system wide store an unconfigured user needs no files at
+         * all - the default location only holds overrides, if it exists */
+        if (!e->ready && e->sysd && faccessat(e->cfd, CONFIG_FILE_REL, F_OK,
+                                0) == -1) {
+                p->resd = strdup(e->rl);
+                return 0;
+        }
+
+        if (!e->ready && p_check_config_dir(e->cl) == 1) {
                 /*printf("Could not create the config directory\n");*/
                 printf("Config directory is already present at "
-                                "%s\n", cl);
+                                "%s\n", e->cl);
         }
 
-        cl = realloc(cl, (strlen(h) + strlen(CONFIG_LOC)
-                                + strlen(CONFIG_FILE) + 1) * sizeof(char));
-        cl = strcat(cl, CONFIG_FILE);
-
-        if (access(cl, F_OK) != -1) {
+        /* a single open decides between reading and creating the file */
+        int fd = openat(e->cfd, CONFIG_FILE_REL, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
                 /* file exists */
-                if ((p_get_filesize(cl) == 0) ||
-                                !(p->resd = p_read_config(cl))) {
+                FILE *f = fdopen(fd, "re");
+                if (!f || !(p->resd = p_read_config(f))) {
                         printf("No configuration present in the file\n"
                                         "Nothing to create/copy\n");
 
                         p_display_config_help();
                         printf("\nProgram will now quit\n");
-                        free(cl);
-                        p_free_res(p);
-                        exit(EXIT_SUCCESS);
+                        if (f)
+                                fclose(f);
+                        else
+                                close(fd);
+                        return 1;
                 }
+                fclose(f);
         } else {
                 /* file doesn't exist - create an empty file */
 		printf("Updating file with the resource directory location\n");
-		char *h = getenv(USER_HOME);
-		char *hcl = calloc(strlen(h) + strlen(CONFIG_RES_LOC) + 1,
+		char *cf = calloc(strlen(e->cl) + strlen(CONFIG_FILE) + 1,
 				sizeof(char));
-		hcl = strcat(hcl, h);
-		hcl = strcat(hcl, CONFIG_RES_LOC);
-		char resl[100];
-		memset(resl, '\0', 100);
-		sprintf(resl, "res_dir_location=%s", hcl);
-                p_write_file(cl, resl);
-
-		free(hcl);
-
-		p->resd = p_read_config(cl);
+		cf = strcat(cf, e->cl);
+		cf = strcat(cf, CONFIG_FILE);
+		char resl[PATH_MAX + sizeof(CONFIG_VAR CONFIG_DELIM)];
+		memset(resl, '\0', sizeof(resl));
+		snprintf(resl, sizeof(resl), "%s%s%s", CONFIG_VAR,
+				CONFIG_DELIM, e->rl);
+                p_write_file(cf, resl);
+		free(cf);
+
+		p->resd = strdup(e->rl);
 		printf("Value of resource directory : %s\n", p->resd);
-                free(cl);
-                return 0;
         }
 
-        free(cl);
         return 0;
 }
 
+int p_skip_token(const jsmntok_t *t, int i)
+{
+        /* every token accounts for its own children, so counting down the
+         * pending ones walks over the whole subtree */
+        for (int r = 1; r > 0; i++)
+                r += t[i].size - 1;
+        return i;
+}
+
 int p_jsoneq(const char *json, jsmntok_t *tok, const char *s)
 {
         if (tok->type == JSMN_STRING &&
@@ -385,43 +1270,6 @@ int p_get_tokenc(const char *s) /* still a un-used function */
         return jsmn_parse(&jp, s, strlen(s), NULL, 0);
 }
 
-jsmntok_t p_get_token_value(const char *jsd, const char *tok_name)
-{
-        jsmntok_t r;
-        r.end = 0;
-        r.size = 0;
-        r.start = 0;
-        r.type = JSMN_UNDEFINED;
-
-        if (!jsd && !tok_name) {
-                printf("JSON data and/or token name has nto been provided\n");
-                return r;
-        }
-
-        /* start the processing and return the value to the calling function */
-        jsmn_parser jp;
-        jsmn_init(&jp);
-        int nt = p_get_tokenc(jsd);
-        if (!nt) {
-                printf("No tokens found\n");
-                return r;
-        }
-        jsmntok_t t[MAXLEN];
-        nt = jsmn_parse(&jp, jsd, strlen(jsd), t, nt);
-        if (nt < 1 || t[0].type != JSMN_OBJECT) {
-                printf("Structure of the JSON object is not proper\n");
-                return r;
-        }
-        for (int i = 1; i < nt; i++) {
-                if (p_jsoneq(jsd, &t[i], tok_name) == 0) {
-                        r = t[i + 1];
-                        break;
-                }
-        }
-
-        return r;
-}
-
 void p_strsplice(const char *s, char *a, int start, int end)
 {
         for (int m = start, l = 0; m < end; m++, l++)
@@ -429,57 +1277,59 @@ void p_strsplice(const char *s, char *a, int start, int end)
         a[end - start] = '\0';
 }
 
-void p_parse_jsdata(const char *jsd, struct project * restrict p)
+static int p_plan_bdirs(const char *js, const jsmntok_t *t, int nt, int o,
+                struct project * restrict p)
 {
-        if (!jsd && !p) {
-                printf("JSON data and/or project structure instance"
-                                " has not been provided\n");
-                return;
+        /*
+         * 1 -> success
+         * 0 -> failure
+         */
+        if (o < 0 || o >= nt || t[o].type != JSMN_ARRAY) {
+                p_fail(p, MKP_ETEMPLATE, "Structure of the JSON object is "
+                                "not proper\n");
+                return 0;
         }
 
-        /*printf("\nJSON data received : %s\n", jsd);*/
-
-        /* directories */
-        jsmntok_t tok_bdirs = p_get_token_value(jsd, TEMPL_DIR_ID);
-        char bdir_str[MAXLEN];
-        memset(bdir_str, 0, MAXLEN * sizeof(char));
-        p_strsplice(jsd, bdir_str, tok_bdirs.start, tok_bdirs.end);
-        p_process_bdirs(bdir_str, p);
+        /* JSON data to be parsed */
+        p_msg(p, "List of directories to be created: %.*s\n",
+                        t[o].end - t[o].start, js + t[o].start);
+
+        int i = o + 1;
+        for (int k = 0; k < t[o].size && i < nt; k++, i = p_skip_token(t, i)) {
+                if (t[i].end - t[i].start >= NAME_MAX) {
+                        p_fail(p, MKP_ETEMPLATE, "Entry %d : name too long - "
+                                        "skipped\n", k + 1);
+                        continue;
+                }
+                char dname[NAME_MAX];
+                memset(dname, 0, NAME_MAX * sizeof(char));
+                p_strsplice(js, dname, t[i].start, t[i].end);
+                char dpath[PATH_MAX];
+                memset(dpath, 0, PATH_MAX * sizeof(char));
+                strcat(dpath, p->pdn);
+                strcat(dpath, "/");
+                strcat(dpath, dname);
+                if (p_plan_dir(p->plan, dpath))
+                        p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+        }
 
-        /* now get the build files to be processed */
-        jsmntok_t tok_bfiles = p_get_token_value(jsd, TEMPL_BUILD_ID);
-        char bfiles_str[MAXLEN];
-        memset(bfiles_str, 0, MAXLEN * sizeof(char));
-        p_strsplice(jsd, bfiles_str, tok_bfiles.start, tok_bfiles.end);
-        p_process_bfiles(bfiles_str, p);
+        return 1;
 }
 
-int p_process_bfiles(const char *s, struct project * restrict p)
+static int p_plan_bfiles(const char *js, const jsmntok_t *t, int nt, int o,
+                struct project * restrict p)
 {
         /*
          * 1 -> success
          * 0 -> failure
          */
-        if (!s && !p) {
-                printf("JSON data and/or project structure instance"
-                                " has not been provided\n");
-                return 0;
-        }
-        printf("Project type specific files to be copied : %s\n", s);
-
-        int nt = p_get_tokenc(s);
-        if (!nt) {
-                printf("No tokens found\n");
-                return 0;
-        }
-        jsmn_parser jp;
-        jsmn_init(&jp);
-        jsmntok_t t[MAXLEN];
-        nt = jsmn_parse(&jp, s, strlen(s), t, nt);
-        if (nt < 1 || t[0].type != JSMN_OBJECT) {
-                printf("Structure of the JSON object is not proper\n");
+        if (o < 0 || o >= nt || t[o].type != JSMN_OBJECT) {
+                p_fail(p, MKP_ETEMPLATE, "Structure of the JSON object is "
+                                "not proper\n");
                 return 0;
         }
+        p_msg(p, "Project type specific files to be copied : %.*s\n",
+                        t[o].end - t[o].start, js + t[o].start);
 
         /*
          * all the files for each project type has to be placed in the same
@@ -488,155 +1338,373 @@ int p_process_bfiles(const char *s, struct project * restrict p)
          * inside the <res_dir_path>/c/<files_here_specific_to_C_json>
          */
 
-        for (int i = 1; i < nt; i += 2) {
+        int i = o + 1;
+        for (int e = 0; e < t[o].size && i + 1 < nt; e++,
+                        i = p_skip_token(t, i + 1)) {
                 /* key == k, value == v */
-                //char k[t[i].end - t[i].start + 1];
-                char k[MAXLEN];
-                char v[MAXLEN];
+                if (t[i].end - t[i].start >= PATH_MAX ||
+                                t[i + 1].end - t[i + 1].start >= NAME_MAX) {
+                        p_fail(p, MKP_ETEMPLATE, "Entry %d : name too long - "
+                                        "skipped\n", 2 * e + 1);
+                        continue;
+                }
+                char k[PATH_MAX];
+                char v[NAME_MAX];
 
                 /* splice the string */
-                p_strsplice(s, k, t[i].start, t[i].end);
-                p_strsplice(s, v, t[i + 1].start, t[i + 1].end);
-
-                /* print the key, value pair */
-                char src[MAXLEN];
-                memset(src, 0, MAXLEN * sizeof(char));
-                strcat(src, p->resd);
-                strcat(src, p->pt);
-                strcat(src, "/");
-                strcat(src, k);
-
-                /* implement check for the directory which will be destination
-                 * - this will be only required for the one which is not going
-                 *   to the root directory */
-                char dest[MAXLEN];
-                memset(dest, 0, MAXLEN * sizeof(char));
-
-                /* first form the source filepath */
-                if (!strcmp(v, ROOT_DIR)) {
-                        strcat(dest, p->pdn);
-                        strcat(dest, "/");
-                        strcat(dest, k);
-
-                        p_copy_file(src, dest);
-                } else {
-                        /*printf("Source file : %s\n", src);*/
-                        /* implement directory check */
-                        char dest_dir[MAXLEN];
-                        memset(dest_dir, 0, MAXLEN * sizeof(char));
-                        strcat(dest_dir, p->pdn);
-                        strcat(dest_dir, "/");
-                        strcat(dest_dir, v);
-                        strcat(dest_dir, "/");
-                        dest_dir[strlen(p->pdn) + strlen(v) + 3] = '\0';
-
-                        if (!p_dir_exists(dest_dir)) {
-                                printf("%s : directory not added in the dirs"
-                                                " list\n",
-                                                dest_dir);
-                                return 0;
-                        }
+                p_strsplice(js, k, t[i].start, t[i].end);
+                p_strsplice(js, v, t[i + 1].start, t[i + 1].end);
 
-                        strcat(dest, p->pdn);
-                        strcat(dest, "/");
-                        strcat(dest, v);
-                        strcat(dest, "/");
-                        strcat(dest, k);
-
-                        p_copy_file(src, dest);
+                if (!p_is_glob(k)) {
+                        p_plan_install(p, k, v, k);
+                        continue;
                 }
+
+                /* patterns are expanded against an index of the resource
+                 * directory which is built once, on the first pattern */
+                if (!p->idx && !(p->idx = p_build_index(p)))
+                        return 0;
+
+                struct p_glob_ctx g = { p, v, p_glob_dirlen(k) };
+                if (!p_index_glob(p->idx, k, p_glob_install, &g))
+                        p_msg(p, "%s : pattern matched no files\n", k);
         }
 
         return 1;
 }
 
-void p_copy_file(const char *src, const char *dest)
+static int p_plan_extras(const char *js, const jsmntok_t *t, int nt, int o,
+                struct project * restrict p)
 {
         /*
-         * implement the checks whether the source file exists or not
-         * if it doesn't - exit the program
+         * 1 -> success
+         * 0 -> failure
          */
-        if (!src && !dest) {
-                printf("Either source location or destination location has "
-                                "not been provided\n");
+        if (!p->with)
+                return 1;
+
+        if (o >= 0 && (o >= nt || t[o].type != JSMN_OBJECT)) {
+                p_fail(p, MKP_ETEMPLATE, "Structure of the JSON object is "
+                                "not proper\n");
+                return 0;
+        }
+
+        char *w = strdup(p->with);
+        if (!w) {
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                return 0;
+        }
+
+        /* each extra is a template of its own - the same two sections are
+         * taken out of it and added to the plan like the main ones */
+        int r = 1;
+        char *sp = NULL;
+        for (char *n = strtok_r(w, EXTRA_DELIM, &sp); n;
+                        n = strtok_r(NULL, EXTRA_DELIM, &sp)) {
+                int x = p_token_value(js, t, nt, o, n);
+                if (x == -1 || t[x].type != JSMN_OBJECT) {
+                        p_fail(p, MKP_ETEMPLATE, "%s : no such extra in the "
+                                        "template\n", n);
+                        r = 0;
+                        continue;
+                }
+
+                p_msg(p, "Adding extra : %s\n", n);
+                int d = p_token_value(js, t, nt, x, TEMPL_DIR_ID);
+                int f = p_token_value(js, t, nt, x, TEMPL_BUILD_ID);
+                if (d != -1 && !p_plan_bdirs(js, t, nt, d, p))
+                        r = 0;
+                if (f != -1 && !p_plan_bfiles(js, t, nt, f, p))
+                        r = 0;
+        }
+
+        free(w);
+        return r;
+}
+
+static void p_resolve(const char *jsd, struct project * restrict p)
+{
+        /*printf("\nJSON data received : %s\n", jsd);*/
+
+        /* the whole template is tokenized once for every section */
+        int nt = 0;
+        jsmntok_t *t = p_tokenize(jsd, strlen(jsd), &nt);
+        if (!t || nt < 1 || t[0].type != JSMN_OBJECT) {
+                p_fail(p, MKP_ETEMPLATE, "Structure of the JSON object is "
+                                "not proper\n");
+                free(t);
                 return;
         }
 
-        FILE *sfile = fopen(src, "rb");
-        if (!sfile) {
-                perror("fopen failed");
+        /* the sections are walked in the tokens of the whole template */
+        int bdirs = p_token_value(jsd, t, nt, 0, TEMPL_DIR_ID);
+        int bfiles = p_token_value(jsd, t, nt, 0, TEMPL_BUILD_ID);
+
+        /* and the optional parts, only looked at when some are asked for */
+        int extras = p_token_value(jsd, t, nt, 0, TEMPL_EXTRA_ID);
+
+        /* hooks are loaded first so that they can start during the copy,
+         * a kept template has them for the projects which are written */
+        int w = p->verify != VERIFY_ONLY || p->fan;
+        for (int i = 1; w && i + 1 < nt; i = p_skip_token(t, i + 1)) {
+                if (p_jsoneq(jsd, &t[i], TEMPL_HOOK_ID))
+                        continue;
+                p->hooks = calloc(1, sizeof(struct p_hooks));
+                if (p->hooks)
+                        p->hooks->out = p->out;
+                if (!p->hooks || p_hooks_load(p->hooks, jsd, t, nt, i + 1)) {
+                        p_fail(p, MKP_ETEMPLATE, "Hooks of the template are "
+                                        "not proper\n");
+                        p_hooks_free(p->hooks);
+                        free(p->hooks);
+                        p->hooks = NULL;
+                        break;
+                }
+                p->hooks->jobs = p->jobs;
+                break;
+        }
+
+        /* the whole template is resolved and checked before the first
+         * write, a run which can not succeed leaves nothing behind */
+        if (!(p->plan = malloc(sizeof(struct p_plan))))
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+        else
+                p_plan_init(p->plan);
+
+        if (p->plan) {
+                p_plan_bdirs(jsd, t, nt, bdirs, p);
+                p_plan_bfiles(jsd, t, nt, bfiles, p);
+                p_plan_extras(jsd, t, nt, extras, p);
+        }
+
+        free(t);
+}
+
+static void p_run(struct project * restrict p)
+{
+        int w = p->verify != VERIFY_ONLY;
+
+        /* every project of a kept template runs hooks of its own */
+        if (w && p->hspec && (!(p->hooks = malloc(sizeof(struct p_hooks))) ||
+                                p_hooks_copy(p->hooks, p->hspec))) {
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                if (p->hooks)
+                        p_hooks_free(p->hooks);
+                free(p->hooks);
+                p->hooks = NULL;
+        }
+        if (p->hooks && !(p->hooks->dir = p_hooks_dir(p)))
+                p_fail(p, MKP_ETEMPLATE, "%s : unable to resolve the "
+                                "directory of the hooks\n", p->pdn);
+
+        if (w && p->plan)
+                p_preflight(p);
+
+        /* the project directory and any missing parent of it */
+        if (w && (p->err || p_make_dirs(p, p->pdn))) {
+                p_msg(p, "%s : nothing has been written\n", p->pdn);
+                p_hooks_free(p->hooks);
+                free(p->hooks);
+                p->hooks = NULL;
+                if (!p->fan) {
+                        p_plan_free(p->plan);
+                        free(p->plan);
+                        p->plan = NULL;
+                }
                 return;
         }
-        /* check if the dir exists - if not - return the control from that
-         * check */
-        FILE *dfile = fopen(dest, "ab");
-        void *d = NULL;
 
-        /* write the portion of the code for copying */
-        if (sfile && dfile) {
-                size_t n = p_get_filesize(src);
-                d = calloc(n, sizeof(size_t));
-                if (fread(d, sizeof(char), n , sfile) != n)
-                        perror("File reading had errors");
-                (void)fwrite(d, sizeof(char), n, dfile);
+        /* an update compares every file anyway and keeps no journal */
+        int resumed = 0;
+        if (w && !p->upd) {
+                int r = 1;
+                if (!(p->jrn = malloc(sizeof(struct p_journal))) ||
+                                (r = p_journal_open(p->jrn, p->dfd, p->pdn,
+                                                    p->resume)) == 1) {
+                        p_msg(p, "%s : unable to keep a journal\n", p->pdn);
+                        if (p->jrn)
+                                p_journal_close(p->jrn, p->dfd, p->pdn, 0);
+                        free(p->jrn);
+                        p->jrn = NULL;
+                } else if (r == 2) {
+                        p_msg(p, "%s : no journal to resume from\n", p->pdn);
+                } else {
+                        resumed = p->resume;
+                }
+        }
+
+        if (w && p->durable != DURABLE_NONE) {
+                if (!(p->dur = malloc(sizeof(struct p_durable))))
+                        p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                else
+                        p_durable_init(p->dur, p->durable, p->dfd, p->pdn);
         }
 
-        fclose(dfile);
-        fclose(sfile);
-        free(d);
+        if (w && p->mkgit) {
+                int r = 0;
+                if (!(p->git = malloc(sizeof(struct p_git))) ||
+                                (r = p_git_init(p->git, p->dfd, p->pdn,
+                                                resumed))) {
+                        if (r == 2)
+                                p_msg(p, "%s is a git repository already - "
+                                                "not initializing\n", p->pdn);
+                        else
+                                p_fail(p, MKP_EGIT, "%s : unable to "
+                                                "initialize git\n", p->pdn);
+                        p_git_free(p->git);
+                        free(p->git);
+                        p->git = NULL;
+                }
+        }
+
+        if (p->verify != VERIFY_NONE) {
+                if (!(p->vfy = malloc(sizeof(struct p_verify))) ||
+                                p_verify_init(p->vfy, p->dfd,
+                                        p->mem ? NULL : p->resd)) {
+                        p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                        p_verify_free(p->vfy);
+                        free(p->vfy);
+                        p->vfy = NULL;
+                }
+        }
+
+        p_build(p);
+
+        if (p->git) {
+                if (p_git_commit(p->git))
+                        p_fail(p, MKP_EGIT, "Unable to write the git "
+                                        "repository\n");
+                p_git_free(p->git);
+                free(p->git);
+                p->git = NULL;
+        }
+
+        /* synced once everything, including the repository, is written */
+        if (p->dur) {
+                if (p_durable_finish(p->dur))
+                        p_fail(p, MKP_ESYNC, "Unable to sync the project to "
+                                        "disk\n");
+                p_durable_free(p->dur);
+                free(p->dur);
+                p->dur = NULL;
+        }
+
+        /* kept for --resume unless every file made it */
+        if (p->jrn) {
+                p_journal_close(p->jrn, p->dfd, p->pdn, !p->err);
+                free(p->jrn);
+                p->jrn = NULL;
+        }
+
+        if (p->hooks) {
+                int f = p_hooks_finish(p->hooks);
+                if (f && !p->code)
+                        p->code = MKP_EHOOK;
+                p->err += f;
+                p_hooks_free(p->hooks);
+                free(p->hooks);
+                p->hooks = NULL;
+        }
+
+        /* checked last, what the hooks changed is part of the project */
+        if (p->vfy) {
+                p_verify_report(p);
+                p_verify_free(p->vfy);
+                free(p->vfy);
+                p->vfy = NULL;
+        }
+
+        if (p->fan)
+                return;
+        p_plan_free(p->plan);
+        free(p->plan);
+        p->plan = NULL;
 }
 
-int p_process_bdirs(const char *s, struct project * restrict p)
+void p_parse_jsdata(const char *jsd, struct project * restrict p)
+{
+        if (!jsd || !p)
+                return;
+
+        int e = p->err;
+        p_resolve(jsd, p);
+
+        /* a template which did not resolve is not kept, every project
+         * reports it on its own */
+        if (p->err != e)
+                p->fan = 0;
+        if (p->fan) {
+                p->hspec = p->hooks;
+                p->hooks = NULL;
+        }
+
+        p_run(p);
+}
+
+int p_process_bfiles(const char *s, struct project * restrict p)
 {
         /*
          * 1 -> success
          * 0 -> failure
          */
-        if (!s && !p) {
-                printf("JSON data and/or project structure instance"
-                                " has not been provided\n");
+        if (!s || !p)
                 return 0;
-        }
 
-        /* JSON data to be parsed */
-        printf("List of directories to be created: %s\n", s);
+        int nt = 0;
+        jsmntok_t *t = p_tokenize(s, strlen(s), &nt);
+        int r = p_plan_bfiles(s, t, t ? nt : 0, 0, p);
+        free(t);
+        return r;
+}
 
-        /* starting to reparse the input string */
-        int nt = p_get_tokenc(s);
-        if (!nt) {
-                printf("No tokens found\n");
-                return 0;
-        }
-        /*printf("Number of tokens found : %d\n", nt);*/
+int p_process_extras(const char *s, struct project * restrict p)
+{
+        /*
+         * 1 -> success
+         * 0 -> failure
+         */
+        if (!p || !p->with)
+                return 1;
 
-        jsmn_parser jp;
-        jsmn_init(&jp);
-        jsmntok_t t[MAXLEN];
-        nt = jsmn_parse(&jp, s, strlen(s), t, nt);
-        if (nt < 1 || t[0].type != JSMN_ARRAY) {
-                printf("Structure of the JSON object is not proper\n");
+        int nt = 0;
+        jsmntok_t *t = s ? p_tokenize(s, strlen(s), &nt) : NULL;
+        if (s && !t) {
+                p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
                 return 0;
         }
+        int r = p_plan_extras(s, t, t ? nt : 0, s ? 0 : -1, p);
+        free(t);
+        return r;
+}
 
-        for (int i = 1; i < nt; i++) {
-                char dname[MAXLEN];
-                memset(dname, 0, MAXLEN * sizeof(char));
-                p_strsplice(s, dname, t[i].start, t[i].end);
-                char dpath[MAXLEN];
-                memset(dpath, 0, MAXLEN * sizeof(char));
-                strcat(dpath, p->pdn);
-                strcat(dpath, "/");
-                strcat(dpath, dname);
-                p_create_dir(dpath);
-        }
+void p_copy_file(const char *src, const char *dest,
+                struct project * restrict p)
+{
+        if (!src || !dest || !p)
+                return;
+        p_copy_at(p, p->rfd, src, dest);
+}
 
-        return 1;
+int p_process_bdirs(const char *s, struct project * restrict p)
+{
+        /*
+         * 1 -> success
+         * 0 -> failure
+         */
+        if (!s || !p)
+                return 0;
+
+        int nt = 0;
+        jsmntok_t *t = p_tokenize(s, strlen(s), &nt);
+        int r = p_plan_bdirs(s, t, t ? nt : 0, 0, p);
+        free(t);
+        return r;
 }
 
 void p_read_template(struct project * restrict p)
 {
-        char fp[MAXLEN];
-        memset(fp, 0, MAXLEN * sizeof(char));
+        char fp[PATH_MAX];
+        memset(fp, 0, PATH_MAX * sizeof(char));
 
         strcat(fp, p->resd);
         strcat(fp, p->pt);
@@ -645,44 +1713,122 @@ void p_read_template(struct project * restrict p)
         char *jsnd = NULL;
         jsnd = p_read_file(fp, jsnd);
 
+        /* the overrides shadow the template of the system layer */
+        if (!jsnd && errno == ENOENT && p->sysd) {
+                snprintf(fp, PATH_MAX, "%s%s%s", p->sysd, p->pt,
+                                RES_EXTENSION);
+                jsnd = p_read_file(fp, jsnd);
+        }
+
         if (jsnd)
                 p_parse_jsdata(jsnd, p);
+        else
+                p_fail(p, MKP_ETEMPLATE, "%s template file can not be read - "
+                                "%s\n", fp, strerror(errno));
 
         free(jsnd);
 }
 
+static void p_existing(struct project * restrict p)
+{
+        if (!p_dir_exists(p->dfd, p->pdn))
+                return;
+
+        /* an existing project is only checked unless it is written to */
+        if (p->verify && !p->upd && !p->resume)
+                p->verify = VERIFY_ONLY;
+        p_msg(p, p->upd ? "Updating existing project\n" :
+                        p->resume ? "Resuming existing project\n" :
+                        p->verify ? "Verifying existing project\n" :
+                        "Dir exists\n");
+}
+
 void p_mkproject(struct project * restrict p)
 {
-        if (p_dir_exists(p->pdn)) {
-                printf("Dir exists\n");
-        } else {
-                p_create_dir(p->pdn);
-        }
+        p_existing(p);
         p_read_template(p);
 }
 
-void p_check_parent_dir(void)
+static void p_drop_kept(struct project * restrict p)
+{
+        /* the resolved template and the mappings of its sources */
+        p_hooks_free(p->hspec);
+        free(p->hspec);
+        p->hspec = NULL;
+        p_plan_free(p->plan);
+        free(p->plan);
+        p->plan = NULL;
+}
+
+void p_mkprojects(struct project * restrict p, char * const *names, int n)
+{
+        if (!p || !names)
+                return;
+
+        int v = p->verify;
+        int e = 0;
+        size_t k = 0;
+        for (int i = 0; i < n; i++) {
+                /* every project is made on its own, a failed one does not
+                 * stop the rest; the first failure keeps its code */
+                e += p->err;
+                p->err = 0;
+                free(p->pdn);
+                if (!(p->pdn = strdup(names[i]))) {
+                        p_fail(p, MKP_ENOMEM, "Unable to allocate memory\n");
+                        break;
+                }
+                if (n > 1)
+                        p_msg(p, "Project %d of %d : %s\n", i + 1, n,
+                                        p->pdn);
+                p->verify = v;
+
+                /* the first project reads the template, the others take
+                 * the plan over and are written from its mapped sources */
+                if (!p->plan) {
+                        p->fan = n > 1;
+                        p_mkproject(p);
+                } else {
+                        p_existing(p);
+                        if (!p_plan_rebase(p->plan, k, p->pdn)) {
+                                p_run(p);
+                        } else {
+                                p_fail(p, MKP_ENOMEM, "Unable to allocate "
+                                                "memory\n");
+                                p_drop_kept(p);
+                        }
+                }
+                k = strlen(p->pdn);
+        }
+        p->err += e;
+        p->fan = 0;
+        p_drop_kept(p);
+}
+
+void p_check_parent_dir(struct p_env * restrict e)
 {
 	/* fixme: something might be missing on this one */
-        char *h = getenv(USER_HOME);
-        char *cl = calloc(strlen(h) + strlen(PARENT_CONF) + 1, sizeof(char));
-        cl = strcat(cl, h);
+        char *cl = calloc(strlen(e->home) + strlen(PARENT_CONF) + 1,
+                        sizeof(char));
+        cl = strcat(cl, e->home);
         cl = strcat(cl, PARENT_CONF);
 
         /* not sure why it is saying that the config directory doesn't exist */
         if (p_check_config_dir(cl) == 1)
 		printf("%s already present\n", cl);
 
+        /* the directory might have been created just now */
+        if (e->cfd == -1)
+                e->cfd = open(cl, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+
 	free(cl);
 }
 
-void p_copy_resources(void)
+void p_copy_resources(const struct p_env * restrict e)
 {
-        char *h = getenv(USER_HOME);
 	char cl[PATH_MAX];
 	memset(cl, '\0', PATH_MAX);
-        strcat(cl, h);
-        strcat(cl, CONFIG_LOC);
+        strcat(cl, e->cl);
 
 	printf("cl value (before checking directory existence : %s\n", cl);
 	DIR *dir = opendir(cl);
@@ -692,17 +1838,130 @@ void p_copy_resources(void)
 	} else if (errno == ENOENT) {
 		printf("Resource directory does not exist -- creating\n");
 		printf("Parent Directory creation status : %s\n",
-				p_create_dir(cl) == 0 ? "Success": "Failed");
+				p_create_dir(AT_FDCWD, cl) == 0 ?
+				"Success": "Failed");
 		memset(cl, '\0', PATH_MAX);
-		strcat(cl, h);
-		strcat(cl, CONFIG_RES_LOC);
+		strcat(cl, e->rl);
 		printf("Resource directory creation status : %s\n",
-				p_create_dir(cl) == 0 ? "Success": "Failed");
-
-		/* cl now points to the target location - .config/mkproject */
+				p_create_dir(AT_FDCWD, cl) == 0 ?
+				"Success": "Failed");
+		strcat(cl, STORE_DIR);
+		printf("Object store creation status : %s\n",
+				p_create_dir(AT_FDCWD, cl) == 0 ?
+				"Success": "Failed");
+
+		/* cl now points to the object store under .config/mkproject/res */
 		printf("cl value (before copying contents): %s\n", cl);
 
-		ftw(RESD_LOC_MASTER, p_copy_contents, 20);
+		/* the files are listed first and copied with the environment
+		 * at hand, no state is kept between the steps of a walk */
+		struct p_index x;
+		if (p_index_build(&x, RESD_LOC_MASTER)) {
+			printf("Unable to read %s\n", RESD_LOC_MASTER);
+			return;
+		}
+		struct p_dirs d;
+		p_dirs_init(&d);
+		for (size_t i = 0; i < x.n; i++)
+			p_copy_contents(e, &d, cl, x.paths[i]);
+		p_dirs_free(&d);
+		p_index_free(&x);
 	} else
 		printf("Failed to check if dir exists\n");
 }
+
+char *p_system_dir(void)
+{
+        /* the system wide store is shared by every user of the host */
+        const char *sd = getenv(SYSTEM_DIR_ENV);
+        struct stat s;
+        if (!sd || !*sd)
+                sd = SYSTEM_RES_DIR;
+        if (stat(sd, &s) || !S_ISDIR(s.st_mode))
+                return NULL;
+
+        size_t n = strlen(sd);
+        char *d = calloc(n + 2, sizeof(char));
+        if (d) {
+                strcat(d, sd);
+                if (n && sd[n - 1] != '/')
+                        strcat(d, "/");
+        }
+        return d;
+}
+
+int p_env_init(struct p_env * restrict e)
+{
+        /*
+         * 1 -> failure
+         * 0 -> success
+         */
+        if (!e) {
+                printf("No environment structure provided\n");
+                return 1;
+        }
+
+        e->cfd = -1;
+        e->ready = false;
+        e->cl = NULL;
+        e->rl = NULL;
+        e->sysd = NULL;
+        e->resd = getenv(RES_DIR_ENV);
+        if (e->resd && !*e->resd)
+                e->resd = NULL;
+
+        if (!(e->home = getenv(USER_HOME))) {
+                printf("%s is not set\n", USER_HOME);
+                return 1;
+        }
+
+        /* every path below ~/.config is derived from these two */
+        e->cl = calloc(strlen(e->home) + strlen(CONFIG_LOC) + 1,
+                        sizeof(char));
+        e->rl = calloc(strlen(e->home) + strlen(CONFIG_RES_LOC) + 1,
+                        sizeof(char));
+        if (!e->cl || !e->rl) {
+                p_env_free(e);
+                return 1;
+        }
+        strcat(strcat(e->cl, e->home), CONFIG_LOC);
+        strcat(strcat(e->rl, e->home), CONFIG_RES_LOC);
+
+        e->sysd = p_system_dir();
+
+        if (e->resd)
+                return 0;
+
+        /* steady state: one fstatat against ~/.config tells that the whole
+         * bootstrap has happened already */
+        struct stat s;
+        char *pc = calloc(strlen(e->home) + strlen(PARENT_CONF) + 1,
+                        sizeof(char));
+        if (pc) {
+                strcat(strcat(pc, e->home), PARENT_CONF);
+                e->cfd = open(pc, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+                free(pc);
+        }
+
+        if (e->cfd != -1 && fstatat(e->cfd, CONFIG_RES_REL, &s, 0) == 0 &&
+                        S_ISDIR(s.st_mode))
+                e->ready = true;
+
+        return 0;
+}
+
+void p_env_free(struct p_env * restrict e)
+{
+        if (!e)
+                return;
+
+        if (e->cfd != -1)
+                close(e->cfd);
+        e->cfd = -1;
+        free(e->cl);
+        free(e->rl);
+        free(e->sysd);
+        e->cl = NULL;
+        e->rl = NULL;
+        e->sysd = NULL;
+}
@@ -0,0 +1,119 @@
+/*
+ * @file 	sha1.c
+ * @author 	sb
+ * @brief 	source file for sha1 header
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../inc/sha1.h"
+
+/* static utility functions */
+static inline uint32_t p_rol(uint32_t x, int r)
+{
+        return (x << r) | (x >> (32 - r));
+}
+
+static void p_sha1_block(struct p_sha1 *s, const unsigned char *b)
+{
+        uint32_t w[80];
+
+        for (int i = 0; i < 16; i++)
+                w[i] = (uint32_t)b[i * 4] << 24 | (uint32_t)b[i * 4 + 1] << 16
+                        | (uint32_t)b[i * 4 + 2] << 8 | b[i * 4 + 3];
+        for (int i = 16; i < 80; i++)
+                w[i] = p_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = s->h[0], bb = s->h[1], c = s->h[2], d = s->h[3];
+        uint32_t e = s->h[4];
+
+        for (int i = 0; i < 80; i++) {
+                uint32_t f, k;
+                if (i < 20) {
+                        f = (bb & c) | (~bb & d);
+                        k = 0x5A827999;
+                } else if (i < 40) {
+                        f = bb ^ c ^ d;
+                        k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                        f = (bb & c) | (bb & d) | (c & d);
+                        k = 0x8F1BBCDC;
+                } else {
+                        f = bb ^ c ^ d;
+                        k = 0xCA62C1D6;
+                }
+
+                uint32_t t = p_rol(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = p_rol(bb, 30);
+                bb = a;
+                a = t;
+        }
+
+        s->h[0] += a;
+        s->h[1] += bb;
+        s->h[2] += c;
+        s->h[3] += d;
+        s->h[4] += e;
+}
+
+/* header functions */
+void p_sha1_init(struct p_sha1 *s)
+{
+        s->h[0] = 0x67452301;
+        s->h[1] = 0xEFCDAB89;
+        s->h[2] = 0x98BADCFE;
+        s->h[3] = 0x10325476;
+        s->h[4] = 0xC3D2E1F0;
+        s->total = 0;
+        s->blksz = 0;
+}
+
+void p_sha1_update(struct p_sha1 *s, const void *d, size_t n)
+{
+        const unsigned char *p = d;
+
+        s->total += n;
+        if (s->blksz) {
+                size_t f = 64 - s->blksz < n ? 64 - s->blksz : n;
+                memcpy(s->blk + s->blksz, p, f);
+                s->blksz += f;
+                p += f;
+                n -= f;
+                if (s->blksz < 64)
+                        return;
+                p_sha1_block(s, s->blk);
+                s->blksz = 0;
+        }
+
+        for (; n >= 64; p += 64, n -= 64)
+                p_sha1_block(s, p);
+
+        memcpy(s->blk, p, n);
+        s->blksz = n;
+}
+
+void p_sha1_final(struct p_sha1 *s, unsigned char *md)
+{
+        uint64_t bits = s->total * 8;
+        unsigned char pad[72] = { 0x80 };
+        size_t pl = (s->blksz < 56 ? 56 : 120) - s->blksz;
+
+        for (int i = 0; i < 8; i++)
+                pad[pl + i] = bits >> (56 - i * 8);
+        p_sha1_update(s, pad, pl + 8);
+
+        for (int i = 0; i < 5; i++) {
+                md[i * 4] = s->h[i] >> 24;
+                md[i * 4 + 1] = s->h[i] >> 16;
+                md[i * 4 + 2] = s->h[i] >> 8;
+                md[i * 4 + 3] = s->h[i];
+        }
+}
+
+void p_sha1_hex(const unsigned char *md, char *s)
+{
+        for (int i = 0; i < SHA1_LEN; i++)
+                snprintf(s + i * 2, 3, "%02x", md[i]);
+}
@@ -0,0 +1,223 @@
+/*
+ * @file 	store.c
+ * @author 	sb
+ * @brief 	source file for store header
+ */
+
+/* mkostemp and the clone ioctl are linux specific */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#include <linux/limits.h>
+#include "../inc/store.h"
+
+/* static utility functions */
+static int p_store_same(int afd, int bfd, off_t n)
+{
+        /*
+         * 1 -> contents are identical
+         * 0 -> contents differ or could not be read
+         */
+        char a[8192];
+        char b[8192];
+
+        if (lseek(afd, 0, SEEK_SET) == -1 || lseek(bfd, 0, SEEK_SET) == -1)
+                return 0;
+
+        while (n > 0) {
+                size_t c = n < (off_t)sizeof(a) ? (size_t)n : sizeof(a);
+                if (read(afd, a, c) != (ssize_t)c ||
+                                read(bfd, b, c) != (ssize_t)c ||
+                                memcmp(a, b, c))
+                        return 0;
+                n -= c;
+        }
+
+        return 1;
+}
+
+static int p_store_seal(int fd, mode_t m)
+{
+        /*
+         * every template sharing the object would see a write through
+         * any one of its links - without write bits an edit in place fails,
+         * and the fixed time shows one made anyway, which permissions do
+         * not stop for root
+         */
+        const struct timespec t[2] = {
+                { 0, UTIME_OMIT },
+                { STORE_MTIME, 0 }
+        };
+
+        if (fchmod(fd, m & 0555) == -1 || futimens(fd, t) == -1)
+                return -1;
+        return 0;
+}
+
+/* header functions */
+int p_store_sealed(const struct stat *s)
+{
+        return !(s->st_mode & 0222) && s->st_mtim.tv_sec == STORE_MTIME &&
+                s->st_mtim.tv_nsec == 0;
+}
+
+mode_t p_store_mode(mode_t m)
+{
+        return (m & 0777) | S_IWUSR;
+}
+
+int p_store_copy_fd(int sfd, int dfd, off_t n)
+{
+        off_t off = 0;
+
+        while (off < n) {
+                ssize_t r = sendfile(dfd, sfd, &off, n - off);
+                if (r == -1 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return -1;
+        }
+
+        return 0;
+}
+
+int p_store_clone(int sfd, int dfd)
+{
+#ifdef FICLONE
+        return ioctl(dfd, FICLONE, sfd) == 0 ? 0 : -1;
+#else
+        (void)sfd;
+        (void)dfd;
+        return -1;
+#endif
+}
+
+int p_store_put(const char *objd, const char *src, char *hex)
+{
+        if (!objd || !src || !hex) {
+                printf("Object directory, source or key buffer "
+                                "not provided\n");
+                return 1;
+        }
+
+        int sfd = open(src, O_RDONLY | O_CLOEXEC);
+        if (sfd == -1) {
+                perror("Unable to open file for the store");
+                return 1;
+        }
+
+        struct stat s;
+        uint64_t h = 0;
+        if (fstat(sfd, &s) == -1 || p_hash_fd(sfd, &h) == -1) {
+                perror("Unable to hash file for the store");
+                close(sfd);
+                return 1;
+        }
+        p_hash_hex(h, hex);
+
+        char op[PATH_MAX];
+        snprintf(op, PATH_MAX, "%s%s", objd, hex);
+
+        /* identical content is stored only once, an object of an older
+         * store is sealed on the way */
+        int ofd = open(op, O_RDONLY | O_CLOEXEC);
+        if (ofd != -1) {
+                struct stat os;
+                int same = fstat(ofd, &os) == 0 && os.st_size == s.st_size
+                        && p_store_same(sfd, ofd, s.st_size);
+                if (same && !p_store_sealed(&os) &&
+                                p_store_seal(ofd, os.st_mode) == -1)
+                        same = 0;
+                close(ofd);
+                if (same) {
+                        close(sfd);
+                        return 0;
+                }
+                /* an object edited in place is replaced below - the links
+                 * of the old templates keep the old inode */
+        }
+
+        /* write to a temporary name so that a partial object never shows
+         * up under its key */
+        char tp[PATH_MAX];
+        snprintf(tp, PATH_MAX, "%s%s", objd, STORE_TMP);
+        int tfd = mkostemp(tp, O_CLOEXEC);
+        if (tfd == -1) {
+                perror("Unable to create object in the store");
+                close(sfd);
+                return 1;
+        }
+
+        int r = 0;
+        if (p_store_clone(sfd, tfd) == -1)
+                r = p_store_copy_fd(sfd, tfd, s.st_size);
+        if (r == 0)
+                r = p_store_seal(tfd, s.st_mode);
+        close(tfd);
+        close(sfd);
+
+        if (r == -1 || rename(tp, op) == -1) {
+                perror("Unable to commit object to the store");
+                unlink(tp);
+                return 1;
+        }
+
+        return 0;
+}
+
+int p_store_link(const char *objd, const char *hex, const char *dest)
+{
+        if (!objd || !hex || !dest) {
+                printf("Object directory, key or destination "
+                                "not provided\n");
+                return 1;
+        }
+
+        char op[PATH_MAX];
+        snprintf(op, PATH_MAX, "%s%s", objd, hex);
+
+        if (link(op, dest) == 0)
+                return 0;
+        if (errno == EEXIST) {
+                /* re-point an old copy at the current object */
+                unlink(dest);
+                if (link(op, dest) == 0)
+                        return 0;
+        }
+
+        /* filesystems without hardlinks still get a reflink or a copy */
+        int sfd = open(op, O_RDONLY | O_CLOEXEC);
+        if (sfd == -1) {
+                perror("Unable to open object");
+                return 1;
+        }
+        unlink(dest);
+        int dfd = open(dest, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, 0600);
+        if (dfd == -1) {
+                perror("Unable to create file at destination");
+                close(sfd);
+                return 1;
+        }
+
+        struct stat s;
+        int r = fstat(sfd, &s);
+        if (r == 0 && p_store_clone(sfd, dfd) == -1)
+                r = p_store_copy_fd(sfd, dfd, s.st_size);
+        if (r == 0)
+                r = p_store_seal(dfd, s.st_mode);
+
+        close(sfd);
+        close(dfd);
+        return r == 0 ? 0 : 1;
+}
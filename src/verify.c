@@ -0,0 +1,293 @@
+/*
+ * @file 	verify.c
+ * @author 	sb
+ * @brief 	source file for verify header
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+#include "../inc/verify.h"
+#include "../inc/store.h"
+
+/* structure */
+struct p_obj {
+        ino_t ino;              /* inode of the object */
+        uint64_t h;             /* hash the object is named after */
+};
+
+struct p_vrun {
+        struct p_verify *v;
+        int ofd;                /* object directory, -1 if there is none */
+        dev_t dev;              /* device of the object directory */
+        struct p_obj *o;        /* objects sorted by inode */
+        size_t no;
+        atomic_size_t next;     /* next entry to be taken by a thread */
+};
+
+/* static utility functions */
+static int p_obj_cmp(const void *a, const void *b)
+{
+        ino_t x = ((const struct p_obj *)a)->ino;
+        ino_t y = ((const struct p_obj *)b)->ino;
+        return (x > y) - (x < y);
+}
+
+static void p_obj_load(struct p_vrun *r, const char *objd)
+{
+        /*
+         * the files of a bootstrapped template are hard links into the
+         * store and every object is named after its hash - one pass over
+         * the object directory gives the hash of every template file
+         * without reading any of them
+         */
+        r->ofd = -1;
+        if (!objd)
+                return;
+
+        DIR *d = opendir(objd);
+        struct stat s;
+        if (!d)
+                return;
+        if (fstat(dirfd(d), &s) == -1) {
+                closedir(d);
+                return;
+        }
+
+        size_t cap = 0;
+        struct dirent *e = NULL;
+        while ((e = readdir(d))) {
+                char *end = NULL;
+                if (strlen(e->d_name) != HASH_HEX_LEN)
+                        continue;
+                uint64_t h = strtoull(e->d_name, &end, 16);
+                if (*end)
+                        continue;
+                if (r->no == cap) {
+                        size_t c = cap ? cap * 2 : VERIFY_CHUNK;
+                        struct p_obj *o = realloc(r->o, c * sizeof(*o));
+                        if (!o)
+                                break;
+                        r->o = o;
+                        cap = c;
+                }
+                r->o[r->no].ino = e->d_ino;
+                r->o[r->no].h = h;
+                r->no++;
+        }
+
+        qsort(r->o, r->no, sizeof(struct p_obj), p_obj_cmp);
+        r->dev = s.st_dev;
+        r->ofd = fcntl(dirfd(d), F_DUPFD_CLOEXEC, 0);
+        closedir(d);
+}
+
+static int p_obj_find(const struct p_vrun *r, const struct stat *s,
+                uint64_t *h)
+{
+        /* a template file with a single link is not an object */
+        if (r->ofd == -1 || s->st_dev != r->dev || s->st_nlink < 2)
+                return 0;
+
+        struct p_obj k = { s->st_ino, 0 };
+        const struct p_obj *o = bsearch(&k, r->o, r->no,
+                        sizeof(struct p_obj), p_obj_cmp);
+        if (!o)
+                return 0;
+
+        /* the entry of the directory is confirmed with the inode of the
+         * object itself, some filesystems report them differently - and
+         * the name is only good for the content while the object is
+         * sealed, one written to since is hashed like any other file */
+        char hex[HASH_HEX_LEN + 1];
+        struct stat os;
+        p_hash_hex(o->h, hex);
+        if (fstatat(r->ofd, hex, &os, 0) == -1 || os.st_ino != s->st_ino ||
+                        os.st_dev != s->st_dev || !p_store_sealed(&os))
+                return 0;
+
+        *h = o->h;
+        return 1;
+}
+
+static int p_hash_path(int dfd, const char *path, uint64_t *h)
+{
+        int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+                return -1;
+
+        int r = p_hash_fd(fd, h);
+        int e = errno;
+        close(fd);
+        errno = e;
+        return r;
+}
+
+static void p_verify_one(const struct p_vrun *r, struct p_vent *e)
+{
+        struct stat ss;
+        uint64_t want = 0;
+        uint64_t got = 0;
+        int known = 0;
+        off_t size = e->n;
+
+        if (e->src) {
+                if (stat(e->src, &ss) == -1) {
+                        e->state = VERIFY_ESOURCE;
+                        e->err = errno;
+                        return;
+                }
+                size = ss.st_size;
+                known = p_obj_find(r, &ss, &want);
+        }
+
+        int fd = openat(r->v->dfd, e->dest, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+                e->state = errno == ENOENT || errno == ENOTDIR ?
+                        VERIFY_MISSING : VERIFY_EREAD;
+                e->err = errno;
+                return;
+        }
+
+        /* a size which differs needs no hash */
+        struct stat ds;
+        if (fstat(fd, &ds) == -1 || (S_ISREG(ds.st_mode) &&
+                                ds.st_size == size &&
+                                p_hash_fd(fd, &got) == -1)) {
+                e->state = VERIFY_EREAD;
+                e->err = errno;
+                close(fd);
+                return;
+        }
+        close(fd);
+        if (!S_ISREG(ds.st_mode) || ds.st_size != size) {
+                e->state = VERIFY_DIFFER;
+                return;
+        }
+
+        if (!known && !e->src) {
+                want = p_hash_buf(e->d, e->n);
+        } else if (!known && p_hash_path(AT_FDCWD, e->src, &want) == -1) {
+                e->state = VERIFY_ESOURCE;
+                e->err = errno;
+                return;
+        }
+
+        e->state = got == want ? VERIFY_SAME : VERIFY_DIFFER;
+}
+
+static void *p_verify_worker(void *arg)
+{
+        /* entries are handed out one at a time, so a few large files do
+         * not leave the other threads idle */
+        struct p_vrun *r = arg;
+        size_t i = 0;
+        while ((i = atomic_fetch_add(&r->next, 1)) < r->v->n)
+                p_verify_one(r, &r->v->e[i]);
+        return NULL;
+}
+
+/* header functions */
+int p_verify_init(struct p_verify *v, int dfd, const char *resd)
+{
+        if (!v)
+                return 1;
+
+        v->dfd = dfd;
+        v->objd = NULL;
+        v->e = NULL;
+        v->n = 0;
+        v->cap = 0;
+
+        if (resd) {
+                size_t n = strlen(resd) + strlen(STORE_DIR) + 1;
+                if (!(v->objd = malloc(n)))
+                        return 1;
+                snprintf(v->objd, n, "%s%s", resd, STORE_DIR);
+        }
+
+        return 0;
+}
+
+int p_verify_add(struct p_verify *v, const char *dest, const char *src,
+                const void *d, size_t n)
+{
+        if (!v || !dest)
+                return 1;
+
+        if (v->n == v->cap) {
+                size_t c = v->cap ? v->cap * 2 : VERIFY_CHUNK;
+                struct p_vent *e = realloc(v->e, c * sizeof(*e));
+                if (!e)
+                        return 1;
+                v->e = e;
+                v->cap = c;
+        }
+
+        struct p_vent *e = &v->e[v->n];
+        memset(e, 0, sizeof(*e));
+        if (!(e->dest = strdup(dest)) || (src && !(e->src = strdup(src)))) {
+                free(e->dest);
+                return 1;
+        }
+        e->d = d;
+        e->n = n;
+        v->n++;
+        return 0;
+}
+
+void p_verify_run(struct p_verify *v, int jobs)
+{
+        if (!v || !v->n)
+                return;
+
+        struct p_vrun r;
+        memset(&r, 0, sizeof(r));
+        r.v = v;
+        atomic_init(&r.next, 0);
+        p_obj_load(&r, v->objd);
+
+        size_t nt = jobs > 1 ? (size_t)jobs : 1;
+        if (nt > v->n)
+                nt = v->n;
+
+        /* the calling thread is one of the nt */
+        pthread_t *t = nt > 1 ? malloc((nt - 1) * sizeof(pthread_t)) : NULL;
+        size_t s = 0;
+        for (size_t i = 1; t && i < nt; i++)
+                if (pthread_create(&t[s], NULL, p_verify_worker, &r) == 0)
+                        s++;
+        p_verify_worker(&r);
+        for (size_t i = 0; i < s; i++)
+                pthread_join(t[i], NULL);
+
+        free(t);
+        free(r.o);
+        if (r.ofd != -1)
+                close(r.ofd);
+}
+
+void p_verify_free(struct p_verify *v)
+{
+        if (!v)
+                return;
+
+        for (size_t i = 0; i < v->n; i++) {
+                free(v->e[i].dest);
+                free(v->e[i].src);
+        }
+        free(v->e);
+        free(v->objd);
+}
@@ -0,0 +1,365 @@
+/*
+ * @file 	count.c
+ * @author 	sb
+ * @brief 	LD_PRELOAD interposer counting the calls a budget is kept for
+ */
+
+/* dlsym with RTLD_NEXT and the __libc_ allocators are glibc specific */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+/* macros */
+#ifndef BUDGET_OUT_ENV
+#define BUDGET_OUT_ENV "BUDGET_OUT"
+#endif
+
+#ifndef BUDGET_PROG_ENV
+#define BUDGET_PROG_ENV "BUDGET_PROG"
+#endif
+
+/* enum */
+enum c_kind {
+        C_OPEN,         /* open, openat, fopen, fdopen, opendir */
+        C_STAT,         /* stat family, access checks and statvfs */
+        C_READ,
+        C_WRITE,
+        C_MKDIR,
+        C_COPY,         /* copy_file_range, sendfile and ioctl - FICLONE */
+        C_SYNC,
+        C_ALLOC,        /* malloc, calloc and realloc */
+        C_KINDS
+};
+
+static const char *c_names[C_KINDS] = {
+        [C_OPEN] = "open",
+        [C_STAT] = "stat",
+        [C_READ] = "read",
+        [C_WRITE] = "write",
+        [C_MKDIR] = "mkdir",
+        [C_COPY] = "copy",
+        [C_SYNC] = "sync",
+        [C_ALLOC] = "alloc"
+};
+
+/* the scaffold copies, hashes and spawns from several threads */
+static unsigned long c_count[C_KINDS];
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t s);
+extern void *__libc_realloc(void *p, size_t n);
+
+/* static utility functions */
+static void c_add(enum c_kind k)
+{
+        __atomic_add_fetch(&c_count[k], 1, __ATOMIC_RELAXED);
+}
+
+static void *c_next(const char *name)
+{
+        /* dlsym may allocate, which goes straight to the __libc_ versions */
+        void *f = dlsym(RTLD_NEXT, name);
+        if (!f)
+                abort();
+        return f;
+}
+
+/* the next definition of the function it is used in, looked up once */
+#define C_NEXT(name) \
+        static __typeof__(&name) next; \
+        if (!next) \
+                next = (__typeof__(&name))c_next(#name)
+
+__attribute__((destructor))
+static void c_dump(void)
+{
+        /*
+         * hooks run through a shell with the same environment, only the
+         * program the budget is for writes its counts
+         */
+        const char *out = getenv(BUDGET_OUT_ENV);
+        const char *prog = getenv(BUDGET_PROG_ENV);
+        if (!out || strcmp(program_invocation_short_name, prog ? prog :
+                                "mkproject"))
+                return;
+
+        unsigned long c[C_KINDS];
+        for (int k = 0; k < C_KINDS; k++)
+                c[k] = __atomic_load_n(&c_count[k], __ATOMIC_RELAXED);
+
+        FILE *f = fopen(out, "w");
+        if (!f)
+                return;
+        for (int k = 0; k < C_KINDS; k++)
+                fprintf(f, "%s %lu\n", c_names[k], c[k]);
+        fclose(f);
+}
+
+/* open */
+int open(const char *p, int fl, ...)
+{
+        C_NEXT(open);
+        mode_t m = 0;
+        if (fl & (O_CREAT | O_TMPFILE)) {
+                va_list ap;
+                va_start(ap, fl);
+                m = va_arg(ap, mode_t);
+                va_end(ap);
+        }
+        c_add(C_OPEN);
+        return next(p, fl, m);
+}
+
+int openat(int d, const char *p, int fl, ...)
+{
+        C_NEXT(openat);
+        mode_t m = 0;
+        if (fl & (O_CREAT | O_TMPFILE)) {
+                va_list ap;
+                va_start(ap, fl);
+                m = va_arg(ap, mode_t);
+                va_end(ap);
+        }
+        c_add(C_OPEN);
+        return next(d, p, fl, m);
+}
+
+FILE *fopen(const char *p, const char *m)
+{
+        C_NEXT(fopen);
+        c_add(C_OPEN);
+        return next(p, m);
+}
+
+FILE *fdopen(int fd, const char *m)
+{
+        C_NEXT(fdopen);
+        c_add(C_OPEN);
+        return next(fd, m);
+}
+
+DIR *opendir(const char *p)
+{
+        C_NEXT(opendir);
+        c_add(C_OPEN);
+        return next(p);
+}
+
+DIR *fdopendir(int fd)
+{
+        C_NEXT(fdopendir);
+        c_add(C_OPEN);
+        return next(fd);
+}
+
+int mkostemp(char *t, int fl)
+{
+        C_NEXT(mkostemp);
+        c_add(C_OPEN);
+        return next(t, fl);
+}
+
+/* stat */
+int stat(const char *p, struct stat *s)
+{
+        C_NEXT(stat);
+        c_add(C_STAT);
+        return next(p, s);
+}
+
+int lstat(const char *p, struct stat *s)
+{
+        C_NEXT(lstat);
+        c_add(C_STAT);
+        return next(p, s);
+}
+
+int fstat(int fd, struct stat *s)
+{
+        C_NEXT(fstat);
+        c_add(C_STAT);
+        return next(fd, s);
+}
+
+int fstatat(int d, const char *p, struct stat *s, int fl)
+{
+        C_NEXT(fstatat);
+        c_add(C_STAT);
+        return next(d, p, s, fl);
+}
+
+int statx(int d, const char *p, int fl, unsigned int m, struct statx *s)
+{
+        C_NEXT(statx);
+        c_add(C_STAT);
+        return next(d, p, fl, m, s);
+}
+
+int access(const char *p, int m)
+{
+        C_NEXT(access);
+        c_add(C_STAT);
+        return next(p, m);
+}
+
+int faccessat(int d, const char *p, int m, int fl)
+{
+        C_NEXT(faccessat);
+        c_add(C_STAT);
+        return next(d, p, m, fl);
+}
+
+int fstatvfs(int fd, struct statvfs *s)
+{
+        C_NEXT(fstatvfs);
+        c_add(C_STAT);
+        return next(fd, s);
+}
+
+/* read and write */
+ssize_t read(int fd, void *b, size_t n)
+{
+        C_NEXT(read);
+        c_add(C_READ);
+        return next(fd, b, n);
+}
+
+ssize_t pread(int fd, void *b, size_t n, off_t o)
+{
+        C_NEXT(pread);
+        c_add(C_READ);
+        return next(fd, b, n, o);
+}
+
+ssize_t readv(int fd, const struct iovec *v, int n)
+{
+        C_NEXT(readv);
+        c_add(C_READ);
+        return next(fd, v, n);
+}
+
+ssize_t write(int fd, const void *b, size_t n)
+{
+        C_NEXT(write);
+        c_add(C_WRITE);
+        return next(fd, b, n);
+}
+
+ssize_t pwrite(int fd, const void *b, size_t n, off_t o)
+{
+        C_NEXT(pwrite);
+        c_add(C_WRITE);
+        return next(fd, b, n, o);
+}
+
+ssize_t writev(int fd, const struct iovec *v, int n)
+{
+        C_NEXT(writev);
+        c_add(C_WRITE);
+        return next(fd, v, n);
+}
+
+/* mkdir */
+int mkdir(const char *p, mode_t m)
+{
+        C_NEXT(mkdir);
+        c_add(C_MKDIR);
+        return next(p, m);
+}
+
+int mkdirat(int d, const char *p, mode_t m)
+{
+        C_NEXT(mkdirat);
+        c_add(C_MKDIR);
+        return next(d, p, m);
+}
+
+/* copy */
+ssize_t copy_file_range(int i, off_t *io, int o, off_t *oo, size_t n,
+                unsigned int fl)
+{
+        C_NEXT(copy_file_range);
+        c_add(C_COPY);
+        return next(i, io, o, oo, n, fl);
+}
+
+ssize_t sendfile(int o, int i, off_t *off, size_t n)
+{
+        C_NEXT(sendfile);
+        c_add(C_COPY);
+        return next(o, i, off, n);
+}
+
+int ioctl(int fd, unsigned long r, ...)
+{
+        C_NEXT(ioctl);
+        va_list ap;
+        va_start(ap, r);
+        void *a = va_arg(ap, void *);
+        va_end(ap);
+        c_add(C_COPY);
+        return next(fd, r, a);
+}
+
+/* sync */
+int fsync(int fd)
+{
+        C_NEXT(fsync);
+        c_add(C_SYNC);
+        return next(fd);
+}
+
+int fdatasync(int fd)
+{
+        C_NEXT(fdatasync);
+        c_add(C_SYNC);
+        return next(fd);
+}
+
+int syncfs(int fd)
+{
+        C_NEXT(syncfs);
+        c_add(C_SYNC);
+        return next(fd);
+}
+
+int sync_file_range(int fd, off_t o, off_t n, unsigned int fl)
+{
+        C_NEXT(sync_file_range);
+        c_add(C_SYNC);
+        return next(fd, o, n, fl);
+}
+
+/* allocation - glibc's own entry points, so dlsym needs no allocator */
+void *malloc(size_t n)
+{
+        c_add(C_ALLOC);
+        return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t s)
+{
+        c_add(C_ALLOC);
+        return __libc_calloc(n, s);
+}
+
+void *realloc(void *p, size_t n)
+{
+        c_add(C_ALLOC);
+        return __libc_realloc(p, n);
+}
@@ -0,0 +1,78 @@
+#!/bin/sh
+# hold every phase of the scaffold to its budget of calls
+#
+# usage: run.sh [--update] mkproject count.so resource-directory
+# each phase runs the C template with its extras under count.so and fails
+# when a count is above the one in <phase>.budget next to this script;
+# --update writes the counts of this run as the new budgets instead
+#
+# the budgets are the exact counts of a run, so a libc which allocates or
+# stats differently fails them - $BUDGET_SLACK allows that many percent
+# over every budget (rounded up) where the libc is not the one they were
+# taken with
+
+set -e
+
+update=
+if [ "$1" = --update ]; then
+	update=1
+	shift
+fi
+
+bin=$1
+so=$2
+resd=$3
+budgets=$(dirname "$0")
+slack=${BUDGET_SLACK:-0}
+
+tmp=$(mktemp -d "${TMPDIR:-/tmp}/mkp-budget-XXXXXX")
+trap 'rm -rf "$tmp"' EXIT
+
+# a fixed number of jobs, the thread pools size themselves from it, and
+# no system wide store, whose lookups would depend on the host
+mkp() {
+	MKP_RES_DIR="$resd" MKP_SYSTEM_DIR="$tmp/system" HOME="$tmp/home" \
+		"$bin" --jobs=4 --with=bench,tests -t c "$@" > /dev/null
+}
+
+# the counted run of a phase, after whatever it needs in place
+counted() {
+	BUDGET_OUT="$tmp/$phase.count" LD_PRELOAD="$so" mkp "$@"
+}
+
+fail=0
+for phase in create update verify git strict; do
+	rm -rf "$tmp/home" "$tmp/p"
+	mkdir -p "$tmp/home"
+	case $phase in
+	create) counted "$tmp/p" ;;
+	update) mkp "$tmp/p"; counted --update "$tmp/p" ;;
+	verify) mkp "$tmp/p"; counted --verify "$tmp/p" ;;
+	git) counted --git "$tmp/p" ;;
+	strict) counted --durability=strict "$tmp/p" ;;
+	esac
+
+	if [ -n "$update" ]; then
+		cp "$tmp/$phase.count" "$budgets/$phase.budget"
+		echo "$phase: budget updated"
+		continue
+	fi
+
+	over=0
+	while read -r name n; do
+		b=$(awk -v k="$name" '$1 == k { print $2 }' \
+			"$budgets/$phase.budget")
+		if [ -z "$b" ]; then
+			echo "$phase: $name $n, no budget"
+			over=1
+		elif [ "$n" -gt $((b + (b * slack + 99) / 100)) ]; then
+			echo "$phase: $name $n over the budget of $b"
+			over=1
+		fi
+	done < "$tmp/$phase.count"
+	[ "$over" = 0 ] || fail=1
+	[ "$over" = 1 ] || echo "$phase: within budget -" \
+		$(tr '\n' ' ' < "$tmp/$phase.count")
+done
+
+exit $fail
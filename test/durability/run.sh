@@ -0,0 +1,67 @@
+#!/bin/sh
+# time the --durability modes on a generated template
+#
+# usage: run.sh [mkproject] [files] [bytes per file] [rounds]
+# the scratch directory is made in $TMPDIR, so point it at the filesystem
+# to be measured; every round starts after a sync, the median is printed
+
+set -e
+
+bin=${1:-build/mkproject}
+files=${2:-1000}
+size=${3:-4096}
+rounds=${4:-5}
+
+dir=$(mktemp -d "${TMPDIR:-/tmp}/mkp-durability-XXXXXX")
+trap 'rm -rf "$dir"' EXIT
+
+# ten directories of files, so batch has directories to sync as well
+mkdir -p "$dir/res/dur"
+printf '{"dirs": [' > "$dir/res/dur.json"
+for d in 0 1 2 3 4 5 6 7 8 9; do
+	[ "$d" = 0 ] || printf ', ' >> "$dir/res/dur.json"
+	printf '"d%s"' "$d" >> "$dir/res/dur.json"
+done
+printf '], "build_files": {' >> "$dir/res/dur.json"
+head -c "$size" /dev/urandom > "$dir/blob"
+i=0
+while [ "$i" -lt "$files" ]; do
+	cp "$dir/blob" "$dir/res/dur/f$i"
+	printf '\001%08d' "$i" | dd of="$dir/res/dur/f$i" conv=notrunc \
+		status=none
+	[ "$i" = 0 ] || printf ', ' >> "$dir/res/dur.json"
+	printf '"f%s": "d%s"' "$i" $((i % 10)) >> "$dir/res/dur.json"
+	i=$((i + 1))
+done
+printf '}}\n' >> "$dir/res/dur.json"
+
+fs=$(df -T "$dir" | awk 'NR == 2 { print $2 }')
+echo "$files files of $size bytes on $fs, median of $rounds rounds"
+
+# the modes take turns within a round, so a machine getting slower or
+# faster over the run shifts all of them alike
+modes="none batch strict"
+for mode in $modes; do
+	: > "$dir/times.$mode"
+done
+r=0
+while [ "$r" -lt "$rounds" ]; do
+	for mode in $modes; do
+		rm -rf "$dir/out"
+		sync
+		t0=$(date +%s%N)
+		MKP_RES_DIR="$dir/res/" HOME="$dir" "$bin" \
+			--durability="$mode" -t dur "$dir/out/p" > /dev/null
+		t1=$(date +%s%N)
+		echo $(((t1 - t0) / 1000)) >> "$dir/times.$mode"
+	done
+	r=$((r + 1))
+done
+
+for mode in $modes; do
+	us=$(sort -n "$dir/times.$mode" | sed -n "$(((rounds + 1) / 2))p")
+	[ "$mode" != none ] || base=$us
+	echo "$mode $us $base $files" | awk '{ printf "  %-7s %8.1f ms" \
+		"  %+8.1f ms over none, %6.1f us per file\n", $1, $2 / 1000,
+		($2 - $3) / 1000, ($2 - $3) / $4 }'
+done
@@ -0,0 +1,152 @@
+/*
+ * @file 	bench.c
+ * @author 	sb
+ * @brief 	throughput of the jsmn scanners on a large template
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../inc/jsmn.h"
+
+/* the same three builds of src/jsmn.c as the fuzz */
+void jsmn_init_scalar(jsmn_parser *parser);
+int jsmn_parse_scalar(jsmn_parser *parser, const char *js, size_t len,
+                jsmntok_t *tokens, unsigned int num_tokens);
+void jsmn_init_sse2(jsmn_parser *parser);
+int jsmn_parse_sse2(jsmn_parser *parser, const char *js, size_t len,
+                jsmntok_t *tokens, unsigned int num_tokens);
+
+/* macros */
+#ifndef BENCH_SIZE
+#define BENCH_SIZE (64 << 20)
+#endif
+
+#ifndef BENCH_ROUNDS
+#define BENCH_ROUNDS 5
+#endif
+
+/* structure */
+struct b_impl {
+        const char *name;
+        void (*init)(jsmn_parser *);
+        int (*parse)(jsmn_parser *, const char *, size_t, jsmntok_t *,
+                        unsigned int);
+};
+
+static const struct b_impl b_impls[] = {
+        { "scalar", jsmn_init_scalar, jsmn_parse_scalar },
+        { "sse2", jsmn_init_sse2, jsmn_parse_sse2 },
+        { "dispatch", jsmn_init, jsmn_parse }
+};
+
+/* static utility functions */
+static char *b_template(size_t size, size_t *n)
+{
+        /*
+         * templates the way they are written by hand - indented, one
+         * build_files entry per line with a path for key, which is what
+         * the string and whitespace scanners spend their time on
+         */
+        char *d = malloc(size + 4096);
+        if (!d)
+                return NULL;
+
+        size_t o = (size_t)sprintf(d, "[\n");
+        for (size_t k = 0; o < size; k++) {
+                o += (size_t)sprintf(d + o, "%s{\n        \"dirs\": [\"src\", "
+                                "\"inc\", \"docs\"],\n        \"build_files\": "
+                                "{\n", k ? ",\n" : "");
+                for (size_t i = 0; i < 24; i++)
+                        o += (size_t)sprintf(d + o, "%s                "
+                                        "\"src/module_%zu/implementation_of_"
+                                        "part_%zu.c\": \"src/module_%zu\"",
+                                        i ? ",\n" : "", k, i, k);
+                o += (size_t)sprintf(d + o, "\n        }\n}");
+        }
+        o += (size_t)sprintf(d + o, "\n]\n");
+        *n = o;
+        return d;
+}
+
+static char *b_read(const char *fp, size_t *n)
+{
+        FILE *f = fopen(fp, "r");
+        if (!f)
+                return NULL;
+
+        char *d = NULL;
+        long sz = -1;
+        if (fseek(f, 0, SEEK_END) == 0 && (sz = ftell(f)) >= 0 &&
+                        fseek(f, 0, SEEK_SET) == 0 && (d = malloc(sz + 1)) &&
+                        fread(d, 1, sz, f) != (size_t)sz) {
+                free(d);
+                d = NULL;
+        }
+        fclose(f);
+        *n = sz;
+        return d;
+}
+
+static double b_now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+        size_t n = 0;
+        char *js = argc > 1 ? b_read(argv[1], &n) : b_template(BENCH_SIZE,
+                        &n);
+        if (!js) {
+                perror(argc > 1 ? argv[1] : "bench");
+                return 2;
+        }
+
+        /* sized once by a counting pass, every round stores all tokens */
+        jsmn_parser jp;
+        jsmn_init_scalar(&jp);
+        int nt = jsmn_parse_scalar(&jp, js, n, NULL, 0);
+        jsmntok_t *t = nt > 0 ? malloc(nt * sizeof(jsmntok_t)) : NULL;
+        if (!t) {
+                fprintf(stderr, "bench : input is not JSON (%d)\n", nt);
+                return 2;
+        }
+
+        printf("jsmn %s: %.1f MiB, %d tokens, best of %d\n",
+                        argc > 1 ? argv[1] : "generated template",
+                        n / 1048576.0, nt, BENCH_ROUNDS);
+        double base = 0;
+        for (size_t i = 0; i < sizeof(b_impls) / sizeof(b_impls[0]); i++) {
+                const struct b_impl *im = &b_impls[i];
+                double best = 0;
+                for (int k = 0; k < BENCH_ROUNDS; k++) {
+                        im->init(&jp);
+                        double t0 = b_now();
+                        int r = im->parse(&jp, js, n, t, nt);
+                        double dt = b_now() - t0;
+                        if (r != nt) {
+                                fprintf(stderr, "bench : %s returned %d\n",
+                                                im->name, r);
+                                return 1;
+                        }
+                        if (!best || dt < best)
+                                best = dt;
+                }
+                if (!base)
+                        base = best;
+                printf("  %-9s %6.2f GB/s  %5.2fx\n", im->name, n / best / 1e9,
+                                base / best);
+        }
+
+        free(t);
+        free(js);
+        return 0;
+}
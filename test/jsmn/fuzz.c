@@ -0,0 +1,403 @@
+/*
+ * @file 	fuzz.c
+ * @author 	sb
+ * @brief 	differential fuzz of the jsmn block scanners against the byte
+ * at a time loops
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../../inc/jsmn.h"
+
+/*
+ * src/jsmn.c is linked three times, the Makefile renames the symbols of
+ * the JSMN_SCALAR and JSMN_NO_AVX2 builds; the plain build picks the widest
+ * scanner of the running CPU
+ */
+void jsmn_init_scalar(jsmn_parser *parser);
+int jsmn_parse_scalar(jsmn_parser *parser, const char *js, size_t len,
+                jsmntok_t *tokens, unsigned int num_tokens);
+void jsmn_init_sse2(jsmn_parser *parser);
+int jsmn_parse_sse2(jsmn_parser *parser, const char *js, size_t len,
+                jsmntok_t *tokens, unsigned int num_tokens);
+
+/* macros */
+#ifndef FUZZ_RUNS
+#define FUZZ_RUNS 100000
+#endif
+
+#ifndef FUZZ_CALLS
+#define FUZZ_CALLS 32
+#endif
+
+#ifndef FUZZ_MUTATIONS
+#define FUZZ_MUTATIONS 2000
+#endif
+
+#if defined(JSMN_STRICT) && defined(JSMN_PARENT_LINKS)
+#define FUZZ_CONF "strict, parent links"
+#elif defined(JSMN_STRICT)
+#define FUZZ_CONF "strict"
+#elif defined(JSMN_PARENT_LINKS)
+#define FUZZ_CONF "parent links"
+#else
+#define FUZZ_CONF "default"
+#endif
+
+/* structure */
+struct f_impl {
+        const char *name;
+        void (*init)(jsmn_parser *);
+        int (*parse)(jsmn_parser *, const char *, size_t, jsmntok_t *,
+                        unsigned int);
+};
+
+/* one parse the way project.c drives it - the token array grows and the
+ * parse resumes whenever jsmn runs out of tokens */
+struct f_run {
+        int r[FUZZ_CALLS];      /* result of every call */
+        size_t nr;
+        jsmn_parser jp;
+        jsmntok_t *t;
+        unsigned int cap;
+};
+
+struct f_buf {
+        char *d;
+        size_t n;
+        size_t cap;
+};
+
+struct f_stats {
+        size_t inputs;
+        size_t tokens;
+        size_t errors;
+};
+
+static const struct f_impl f_impls[] = {
+        { "scalar", jsmn_init_scalar, jsmn_parse_scalar },
+        { "sse2", jsmn_init_sse2, jsmn_parse_sse2 },
+        { "dispatch", jsmn_init, jsmn_parse }
+};
+
+#define F_NIMPL (sizeof(f_impls) / sizeof(f_impls[0]))
+
+static uint64_t f_state = 0x9E3779B97F4A7C15ULL;
+static const char *f_out = NULL;
+
+/* static utility functions */
+static uint32_t f_rand(void)
+{
+        /* xorshift64*, so a seed replays a failure exactly */
+        f_state ^= f_state >> 12;
+        f_state ^= f_state << 25;
+        f_state ^= f_state >> 27;
+        return (f_state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static void f_put(struct f_buf *b, const char *s, size_t n)
+{
+        if (b->n + n > b->cap) {
+                size_t cap = b->cap ? b->cap : 256;
+                while (cap < b->n + n)
+                        cap *= 2;
+                if (!(b->d = realloc(b->d, cap))) {
+                        perror("fuzz");
+                        exit(2);
+                }
+                b->cap = cap;
+        }
+
+        memcpy(b->d + b->n, s, n);
+        b->n += n;
+}
+
+static void f_putc(struct f_buf *b, char c)
+{
+        f_put(b, &c, 1);
+}
+
+static void f_space(struct f_buf *b)
+{
+        /* long runs cross the 16 and 32 byte blocks at every offset */
+        static const char ws[] = " \t\r\n";
+        size_t k = f_rand() % 4 ? f_rand() % 3 : f_rand() % 80;
+
+        while (k--)
+                f_putc(b, f_rand() % 5 ? ' ' : ws[f_rand() % 4]);
+}
+
+static void f_string(struct f_buf *b)
+{
+        static const char hex[] = "0123456789abcdefABCDEFgx";
+        size_t k = f_rand() % 3 == 0 ? f_rand() % 8 : f_rand() % 90;
+
+        f_putc(b, '"');
+        while (k--) {
+                unsigned int r = f_rand() % 100;
+                if (r < 70) {
+                        f_putc(b, 'a' + f_rand() % 26);
+                } else if (r < 78) {
+                        f_putc(b, ' ');
+                } else if (r < 82) {
+                        f_put(b, "\\\"", 2);
+                } else if (r < 85) {
+                        f_put(b, "\\\\", 2);
+                } else if (r < 88) {
+                        f_put(b, "\\u", 2);
+                        for (int i = 0; i < 4; i++)
+                                f_putc(b, hex[f_rand() % (f_rand() % 8 ?
+                                                        22 : 24)]);
+                } else if (r < 90) {
+                        f_putc(b, '\\');
+                        f_putc(b, "nrtbf/x"[f_rand() % 7]);
+                } else if (r < 93) {
+                        f_putc(b, 0x80 + f_rand() % 128);
+                } else if (r < 94) {
+                        f_putc(b, '\0');
+                } else if (r < 96) {
+                        f_putc(b, "\n\t"[f_rand() % 2]);
+                } else {
+                        f_putc(b, "/:,{}[]"[f_rand() % 7]);
+                }
+        }
+        f_putc(b, '"');
+}
+
+static void f_primitive(struct f_buf *b)
+{
+        static const char *p[] = { "true", "false", "null", "0", "-12.5e3",
+                "1234567890", "tru", "nul", "x", "+1" };
+        const char *s = p[f_rand() % (sizeof(p) / sizeof(p[0]))];
+
+        f_put(b, s, strlen(s));
+}
+
+static void f_value(struct f_buf *b, int depth)
+{
+        unsigned int r = depth > 6 ? 4 + f_rand() % 6 : f_rand() % 10;
+        size_t k = f_rand() % 6;
+
+        if (r < 4) {
+                f_putc(b, r < 2 ? '{' : '[');
+                f_space(b);
+                for (size_t i = 0; i < k; i++) {
+                        if (i) {
+                                f_putc(b, ',');
+                                f_space(b);
+                        }
+                        if (r < 2) {
+                                f_string(b);
+                                f_space(b);
+                                f_putc(b, ':');
+                                f_space(b);
+                        }
+                        f_value(b, depth + 1);
+                        f_space(b);
+                }
+                f_putc(b, r < 2 ? '}' : ']');
+        } else if (r < 7) {
+                f_string(b);
+        } else {
+                f_primitive(b);
+        }
+}
+
+static void f_mutate(struct f_buf *b)
+{
+        static const char m[] = "{}[]\":,\\ \t\n\0a1";
+
+        for (unsigned int k = 1 + f_rand() % 4; k-- && b->n; ) {
+                size_t i = f_rand() % b->n;
+                switch (f_rand() % 4) {
+                case 0:
+                        b->d[i] = m[f_rand() % (sizeof(m) - 1)];
+                        break;
+                case 1:
+                        memmove(b->d + i, b->d + i + 1, b->n - i - 1);
+                        b->n--;
+                        break;
+                case 2:
+                        b->n = i;
+                        break;
+                default:
+                        b->d[i] ^= 1 << (f_rand() % 8);
+                        break;
+                }
+        }
+}
+
+static void f_parse(const struct f_impl *im, const char *js, size_t n,
+                unsigned int cap, struct f_run *r)
+{
+        /* cap 0 counts the tokens without storing them */
+        r->nr = 0;
+        r->cap = cap;
+        r->t = cap ? malloc(cap * sizeof(jsmntok_t)) : NULL;
+        im->init(&r->jp);
+
+        for (;;) {
+                int v = im->parse(&r->jp, js, n, r->t, r->cap);
+                r->r[r->nr++] = v;
+                if (v != JSMN_ERROR_NOMEM || !cap || r->nr == FUZZ_CALLS)
+                        break;
+                r->cap *= 2;
+                if (!(r->t = realloc(r->t, r->cap * sizeof(jsmntok_t)))) {
+                        perror("fuzz");
+                        exit(2);
+                }
+        }
+}
+
+static int f_same(const struct f_run *a, const struct f_run *b)
+{
+        if (a->nr != b->nr || memcmp(a->r, b->r, a->nr * sizeof(int)) ||
+                        a->jp.pos != b->jp.pos ||
+                        a->jp.toknext != b->jp.toknext ||
+                        a->jp.toksuper != b->jp.toksuper)
+                return 0;
+
+        for (unsigned int i = 0; a->t && i < a->jp.toknext; i++) {
+                const jsmntok_t *x = &a->t[i];
+                const jsmntok_t *y = &b->t[i];
+                if (x->type != y->type || x->start != y->start ||
+                                x->end != y->end || x->size != y->size)
+                        return 0;
+#ifdef JSMN_PARENT_LINKS
+                if (x->parent != y->parent)
+                        return 0;
+#endif
+        }
+
+        return 1;
+}
+
+static void f_fail(const struct f_impl *im, const char *d, size_t n,
+                unsigned int cap, const char *origin)
+{
+        fprintf(stderr, "jsmn " FUZZ_CONF " : %s differs from scalar on %s "
+                        "(%zu bytes, %u tokens)\n", im->name, origin, n, cap);
+        FILE *f = f_out ? fopen(f_out, "w") : NULL;
+        if (f) {
+                fwrite(d, 1, n, f);
+                fclose(f);
+                fprintf(stderr, "input written to %s\n", f_out);
+        }
+        exit(1);
+}
+
+static void f_check(const char *s, size_t n, struct f_stats *st,
+                const char *origin)
+{
+        /* an exact copy, so a scanner reading past len is caught by the
+         * address sanitizer */
+        char *d = malloc(n ? n : 1);
+        if (!d) {
+                perror("fuzz");
+                exit(2);
+        }
+        memcpy(d, s, n);
+
+        unsigned int caps[] = { 0, 1 + f_rand() % 8, n + 1 };
+        for (size_t c = 0; c < sizeof(caps) / sizeof(caps[0]); c++) {
+                struct f_run ref;
+                f_parse(&f_impls[0], d, n, caps[c], &ref);
+                for (size_t i = 1; i < F_NIMPL; i++) {
+                        struct f_run r;
+                        f_parse(&f_impls[i], d, n, caps[c], &r);
+                        int same = f_same(&ref, &r);
+                        free(r.t);
+                        if (!same)
+                                f_fail(&f_impls[i], d, n, caps[c], origin);
+                }
+                if (caps[c]) {
+                        st->tokens += ref.jp.toknext;
+                        st->errors += ref.r[ref.nr - 1] < 0;
+                }
+                free(ref.t);
+        }
+
+        st->inputs++;
+        free(d);
+}
+
+static int f_file(const char *fp, struct f_stats *st)
+{
+        FILE *f = fopen(fp, "r");
+        if (!f) {
+                perror(fp);
+                return 1;
+        }
+
+        struct f_buf b = { NULL, 0, 0 };
+        char c[4096];
+        size_t k;
+        while ((k = fread(c, 1, sizeof(c), f)))
+                f_put(&b, c, k);
+        fclose(f);
+
+        /* as it is, then damaged the way the generated inputs are */
+        f_check(b.d ? b.d : "", b.n, st, fp);
+        struct f_buf m = { NULL, 0, 0 };
+        for (int i = 0; i < FUZZ_MUTATIONS; i++) {
+                m.n = 0;
+                f_put(&m, b.d ? b.d : "", b.n);
+                f_mutate(&m);
+                f_check(m.d ? m.d : "", m.n, st, fp);
+        }
+
+        free(m.d);
+        free(b.d);
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        long runs = FUZZ_RUNS;
+        int i = 1;
+
+        for (; i < argc && argv[i][0] == '-'; i++) {
+                if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+                        runs = atol(argv[++i]);
+                } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+                        f_state = strtoull(argv[++i], NULL, 0) | 1;
+                } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+                        f_out = argv[++i];
+                } else {
+                        fprintf(stderr, "usage: %s [-n runs] [-s seed] "
+                                        "[-o failing-input] [corpus...]\n",
+                                        argv[0]);
+                        return 2;
+                }
+        }
+
+        struct f_stats st = { 0, 0, 0 };
+        for (; i < argc; i++)
+                if (f_file(argv[i], &st))
+                        return 2;
+
+        struct f_buf b = { NULL, 0, 0 };
+        char origin[64];
+        for (long k = 0; k < runs; k++) {
+                b.n = 0;
+                f_space(&b);
+                f_value(&b, 0);
+                f_space(&b);
+                if (f_rand() % 3 == 0)
+                        f_mutate(&b);
+                snprintf(origin, sizeof(origin), "generated input %ld", k);
+                f_check(b.d ? b.d : "", b.n, &st, origin);
+        }
+        free(b.d);
+
+        printf("jsmn %-20s %zu inputs, %zu tokens, %zu rejected - the "
+                        "scanners agree\n", FUZZ_CONF ":", st.inputs,
+                        st.tokens, st.errors);
+        return 0;
+}